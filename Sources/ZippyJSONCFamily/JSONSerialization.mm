@@ -2,6 +2,12 @@
 
 // NOTE: ARC is disabled for this file
 
+// Lets document streams run stage 1 of the next batch on a worker thread. simdjson still turns this off for unoptimized
+// Apple builds, because of their small secondary thread stacks
+#ifndef SIMDJSON_THREADS_ENABLED
+#define SIMDJSON_THREADS_ENABLED
+#endif
+
 #import "simdjson.h"
 #import "JSONSerialization.h"
 #import <CoreFoundation/CoreFoundation.h>
@@ -11,9 +17,16 @@
 #import <string.h>
 #import <atomic>
 #import <mutex>
+#import <condition_variable>
 #import <typeinfo>
 #import <deque>
+#import <unordered_map>
+#import <thread>
 #import <dispatch/dispatch.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
 
 
 #define JNT_UNLIKELY(x) __builtin_expect(!!(x), 0)
@@ -26,16 +39,6 @@ static inline char JNTStringPop(char **string) {
     return c;
 }
 
-bool JNTHasVectorExtensions() {
-#ifdef __SSE4_2__
-  return true;
-#elif defined(__arm64__)
-  return true;
-#else
-  return false;
-#endif
-}
-
 static inline JNTDecoder JNTCreateDecoder(dom::element element, JNTContext *context, size_t depth) {
     JNTDecoder decoder;
     decoder.element = element;
@@ -60,10 +63,128 @@ struct JNTDecodingError {
     }
 };
 
-struct JNTContext { // static for classes?
-public:
+// The on-demand engine's view of a document: only stage 1 has been run on it, and values are found by walking the
+// structural indexes. Strings (including keys) are unescaped in place, and NUL-terminated, the first time they're read
+struct JNTLazyDocument {
+    std::unique_ptr<internal::dom_parser_implementation> implementation;
+    padded_string json;
+    uint8_t *buf = NULL;
+    size_t length = 0;
+    uint32_t *structurals = NULL;
+    uint32_t structuralCount = 0;
+    std::vector<bool> materialized;
+    std::string unescapeBuffer;
+    // Set once every string has been materialized for readers on other threads, after which nothing is written
+    bool frozen = false;
+};
+
+// A file mapped for the lifetime of a context. The mapping extends at least SIMDJSON_PADDING bytes past the end of the
+// file, and those bytes are all zero, whether they come from the rest of the last page or from anonymous pages after it
+struct JNTMappedFile {
+    void *base = MAP_FAILED;
+    size_t mappedLength = 0;
+    size_t length = 0;
+
+    ~JNTMappedFile() {
+        if (base != MAP_FAILED) {
+            munmap(base, mappedLength);
+        }
+    }
+};
+
+// Newline-delimited (or just concatenated) documents, parsed one at a time into the context's parser
+struct JNTDocumentStream {
+    padded_string json;
+    dom::document_stream stream;
+    dom::document_stream::iterator iterator;
+    // The iterator only moves on when the next document is asked for, since moving on overwrites the current one
+    bool started = false;
+
+    JNTDocumentStream(padded_string &&json, dom::document_stream &&stream) : json(std::move(json)), stream(std::move(stream)) {
+    }
+};
+
+// JSON that arrives in chunks, accumulated with room for the padding so that it can be parsed in place at the end, and
+// indexed as it arrives
+struct JNTFeedBuffer {
+    std::unique_ptr<uint8_t[]> data;
+    size_t length = 0;
+    size_t capacity = 0;
+    // The parser that stage 1 is running on, if it's been started for what's in the buffer
+    internal::dom_parser_implementation *indexer = NULL;
+};
+
+// Part of a top-level array too large to parse as a single document, copied out with brackets around it
+struct JNTArrayChunk {
+    padded_string json;
+    dom::parser parser;
+    dom::element root;
+    dom::array array;
+    // The index of the chunk's first element in the array as a whole
+    size_t firstElement = 0;
+    size_t count = 0;
+};
+
+// A top-level array split into chunks that are parsed separately. The root is an empty array in a document of its own,
+// so that it behaves like an array everywhere, and iterators over it step from the end of one chunk to the start of
+// the next
+struct JNTChunkedDocument {
+    dom::parser rootParser;
+    dom::element root;
+    std::vector<std::unique_ptr<JNTArrayChunk>> chunks;
+    size_t count = 0;
+};
+
+// What the host did with a single document, to be folded into the stats for its model type
+struct JNTDecodeStats {
+    bool parsed = false;
+    bool countsFieldsPresent = false;
+    uint64_t bytes = 0;
+    uint64_t fieldsRead = 0;
+    uint64_t fieldsPresent = 0;
+    uint64_t lookups = 0;
+    uint64_t rewinds = 0;
+};
+
+// The parsed document and everything that it points into. Contexts share it with the readers created from them, and
+// once it's shared it's never modified: a context that parses again gets a new one
+struct JNTParsedDocument {
     dom::parser parser;
     dom::element root;
+    std::unique_ptr<JNTLazyDocument> lazyDocument;
+    std::unique_ptr<JNTMappedFile> mappedFile;
+    // Declared after the parser, which the stream points to, so it's destroyed (and its worker joined) first
+    std::unique_ptr<JNTDocumentStream> documentStream;
+    JNTFeedBuffer feedBuffer;
+    std::unique_ptr<JNTChunkedDocument> chunkedDocument;
+
+    const char *originalString;
+    uint32_t originalStringLength;
+    // The simdjson implementation that the parsers were (or will be) created with
+    const simdjson::implementation *implementation = NULL;
+
+    // Set once a reader has been created, after which anything that would modify the document in place (converting
+    // keys to camel case, or unescaping strings on demand) is done for the whole document, once
+    std::atomic<bool> shared{false};
+    std::once_flag materializeOnce;
+    std::once_flag snakeCaseOnce;
+
+    JNTParsedDocument(const char *originalString, uint32_t originalStringLength) : originalString(originalString), originalStringLength(originalStringLength) {
+    }
+};
+
+struct JNTContext { // static for classes?
+public:
+    std::shared_ptr<JNTParsedDocument> document;
+    JNTDecoderEngine engine = JNTDecoderEngineDOM;
+    // NULL to use the process-wide one
+    const simdjson::implementation *implementation = NULL;
+    bool trusted = false;
+    size_t maxDepth = DEFAULT_MAX_DEPTH;
+    const void *modelType = NULL;
+    JNTDecodeStats stats;
+    NSInteger parallelRangeCount = 0;
+    NSInteger parallelMinimumLength = 0;
     JNTDecodingError error;
     std::string snakeCaseBuffer;
 
@@ -72,10 +193,7 @@ public:
     std::string nanString;
     BOOL stringsForFloats;
 
-    const char *originalString;
-    uint32_t originalStringLength;
-
-    JNTContext(const char *originalString, uint32_t originalStringLength, std::string posInfString, std::string negInfString, std::string nanString, BOOL stringsForFloats) : originalString(originalString), originalStringLength(originalStringLength), posInfString(posInfString), negInfString(negInfString), nanString(nanString), stringsForFloats(stringsForFloats) {
+    JNTContext(const char *originalString, uint32_t originalStringLength, std::string posInfString, std::string negInfString, std::string nanString, BOOL stringsForFloats) : document(std::make_shared<JNTParsedDocument>(originalString, originalStringLength)), posInfString(posInfString), negInfString(negInfString), nanString(nanString), stringsForFloats(stringsForFloats) {
     }
 };
 
@@ -163,6 +281,436 @@ static void JNTHandleNumberDoesNotFit(JNTDecoder decoder, T number, const char *
     JNTSetError(description, JNTDecodingErrorTypeNumberDoesNotFit, decoder.context, decoder, "");
 }
 
+static void JNTHandleInvalidRawValue(JNTDecoder decoder, std::string_view rawValue) {
+    std::ostringstream oss;
+    oss << "Cannot initialize enum from invalid String value " << rawValue << ".";
+    JNTSetError(oss.str(), JNTDecodingErrorTypeInvalidRawValue, decoder.context, decoder, "");
+}
+
+static void JNTHandleMalformedJSON(JNTDecoder decoder) {
+    JNTSetError("The given data was not valid JSON.", JNTDecodingErrorTypeJSONParsingFailed, decoder.context, decoder, "");
+}
+
+// On-demand engine
+//
+// Elements and iterators keep their usual layout, but the document pointer is tagged with the low bit and the tape
+// index is instead an index into the structural indexes. A value is found by skipping over its siblings' tokens
+
+template <typename T>
+static inline T JNTLazyMake(JNTLazyDocument *document, uint32_t index) {
+    T value;
+    auto tape = (internal::tape_ref *)&value;
+    tape->doc = (const dom::document *)((uintptr_t)document | 1);
+    tape->json_index = index;
+    return value;
+}
+
+template <typename T>
+static inline JNTLazyDocument *JNTLazyDocumentFrom(const T &value) {
+    const auto tape = (const internal::tape_ref *)&value;
+    uintptr_t doc = (uintptr_t)tape->doc;
+    return (doc & 1) ? (JNTLazyDocument *)(doc & ~(uintptr_t)1) : NULL;
+}
+
+template <typename T>
+static inline uint32_t JNTLazyIndex(const T &value) {
+    const auto tape = (const internal::tape_ref *)&value;
+    return (uint32_t)tape->json_index;
+}
+
+static inline uint8_t JNTLazyChar(JNTLazyDocument *document, uint32_t index) {
+    if (JNT_UNLIKELY(index >= document->structuralCount)) {
+        return '\0';
+    }
+    return document->buf[document->structurals[index]];
+}
+
+static inline bool JNTLazyIsNumberStart(uint8_t c) {
+    return c == '-' || ('0' <= c && c <= '9');
+}
+
+// Returns the index of the token after the value at index (or structuralCount if the containers never close)
+static inline uint32_t JNTLazySkip(JNTLazyDocument *document, uint32_t index) {
+    uint8_t c = JNTLazyChar(document, index);
+    if (c != '{' && c != '[') {
+        return index + 1;
+    }
+    size_t depth = 0;
+    for (; index < document->structuralCount; index++) {
+        switch (document->buf[document->structurals[index]]) {
+            case '{':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                depth--;
+                if (depth == 0) {
+                    return index + 1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return document->structuralCount;
+}
+
+static inline bool JNTLazyIsKey(JNTLazyDocument *document, uint32_t index) {
+    return JNTLazyChar(document, index) == '"' && JNTLazyChar(document, index + 1) == ':';
+}
+
+// Given the index of a key, returns the index of the next key, or of the closing brace (or structuralCount if the
+// object is malformed)
+static inline uint32_t JNTLazyNextKey(JNTLazyDocument *document, uint32_t index) {
+    uint32_t next = JNTLazySkip(document, index + 2);
+    switch (JNTLazyChar(document, next)) {
+        case ',':
+            return JNTLazyIsKey(document, next + 1) ? next + 1 : document->structuralCount;
+        case '}':
+            return next;
+        default:
+            return document->structuralCount;
+    }
+}
+
+static inline bool JNTLazyIsElement(JNTLazyDocument *document, uint32_t index) {
+    switch (JNTLazyChar(document, index)) {
+        case ']':
+        case '}':
+        case ',':
+        case ':':
+        case '\0':
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Given the index of an array element, returns the index of the next element, or of the closing bracket (or
+// structuralCount if the array is malformed)
+static inline uint32_t JNTLazyNextElement(JNTLazyDocument *document, uint32_t index) {
+    uint32_t next = JNTLazySkip(document, index);
+    switch (JNTLazyChar(document, next)) {
+        case ',':
+            return JNTLazyIsElement(document, next + 1) ? next + 1 : document->structuralCount;
+        case ']':
+            return next;
+        default:
+            return document->structuralCount;
+    }
+}
+
+// Returns the string starting at index, unescaping it in place if this is the first time it's been read
+static const char *JNTLazyString(JNTLazyDocument *document, uint32_t index) {
+    uint8_t *start = document->buf + document->structurals[index] + 1;
+    if (document->materialized[index]) {
+        return (const char *)start;
+    }
+    if (JNT_UNLIKELY(document->frozen)) {
+        // It failed to unescape when the document was frozen
+        return NULL;
+    }
+    // Stage 1 has already checked that the string is closed
+    uint8_t *end = start;
+    while (*end != '"' && *end != '\\') {
+        end++;
+    }
+    if (JNT_UNLIKELY(*end == '\\')) {
+        size_t rawEnd = index + 1 < document->structuralCount ? document->structurals[index + 1] : document->length;
+        document->unescapeBuffer.resize(rawEnd - document->structurals[index] + SIMDJSON_PADDING);
+        uint8_t *unescaped = (uint8_t *)&document->unescapeBuffer[0];
+        uint8_t *unescapedEnd = document->implementation->parse_string(start, unescaped);
+        if (!unescapedEnd) {
+            return NULL;
+        }
+        // Unescaping never makes a string longer
+        memcpy(start, unescaped, unescapedEnd - unescaped);
+        end = start + (unescapedEnd - unescaped);
+    }
+    *end = '\0';
+    document->materialized[index] = true;
+    return (const char *)start;
+}
+
+static inline bool JNTLazyKeyEquals(JNTLazyDocument *document, uint32_t index, const char *key) {
+    if (!document->materialized[index]) {
+        // Compare against the raw bytes, so that keys that don't match never need to be unescaped
+        const uint8_t *raw = document->buf + document->structurals[index] + 1;
+        size_t i = 0;
+        for (; raw[i] != '"' && raw[i] != '\\'; i++) {
+            if (raw[i] != (uint8_t)key[i]) {
+                return false;
+            }
+        }
+        if (raw[i] == '"') {
+            return key[i] == '\0';
+        }
+    }
+    const char *string = JNTLazyString(document, index);
+    return string && strcmp(string, key) == 0;
+}
+
+// Mirrors the parts of dom::element that the decoding templates use, reading the value straight from the JSON text
+struct JNTLazyValue {
+    JNTLazyDocument *document;
+    uint32_t index;
+
+    JNTLazyValue(JNTLazyDocument *document, uint32_t index) : document(document), index(index) {
+    }
+
+    const uint8_t *start() const {
+        return document->buf + document->structurals[index];
+    }
+
+    size_t remaining() const {
+        return document->length - document->structurals[index];
+    }
+
+    // The number parsers need something other than the padding after a number, so one at the very end of the JSON (which
+    // can only be the root) is parsed from a copy that's followed by spaces instead
+    const uint8_t *numberStart(std::unique_ptr<uint8_t[]> &copy) const {
+        if (simdjson_likely(index + 1 < document->structuralCount)) {
+            return start();
+        }
+        copy.reset(new uint8_t[remaining() + SIMDJSON_PADDING]);
+        memcpy(copy.get(), start(), remaining());
+        memset(copy.get() + remaining(), ' ', SIMDJSON_PADDING);
+        return copy.get();
+    }
+
+    dom::element_type type() const {
+        uint8_t c = JNTLazyChar(document, index);
+        switch (c) {
+            case '{':
+                return dom::element_type::OBJECT;
+            case '[':
+                return dom::element_type::ARRAY;
+            case '"':
+                return dom::element_type::STRING;
+            case 't':
+            case 'f':
+                return dom::element_type::BOOL;
+            case 'n':
+                return dom::element_type::NULL_VALUE;
+            default:
+                return dom::element_type::DOUBLE;
+        }
+    }
+
+    bool is_null() const {
+        return JNTLazyChar(document, index) == 'n' && builtin::atomparsing::is_valid_null_atom(start(), remaining());
+    }
+
+    template <typename T>
+    simdjson_result<T> get() const;
+
+    template <typename T>
+    bool is() const {
+        return !get<T>().error();
+    }
+};
+
+template <>
+simdjson_result<int64_t> JNTLazyValue::get<int64_t>() const {
+    if (!JNTLazyIsNumberStart(JNTLazyChar(document, index))) {
+        return INCORRECT_TYPE;
+    }
+    std::unique_ptr<uint8_t[]> copy;
+    const uint8_t *number = numberStart(copy);
+    auto numberType = builtin::numberparsing::get_number_type(number);
+    if (numberType.error()) {
+        return numberType.error();
+    }
+    switch (numberType.value_unsafe()) {
+        case ondemand::number_type::signed_integer:
+            return builtin::numberparsing::parse_integer(number);
+        case ondemand::number_type::unsigned_integer:
+            return NUMBER_OUT_OF_RANGE;
+        default:
+            return INCORRECT_TYPE;
+    }
+}
+
+template <>
+simdjson_result<uint64_t> JNTLazyValue::get<uint64_t>() const {
+    if (!JNTLazyIsNumberStart(JNTLazyChar(document, index))) {
+        return INCORRECT_TYPE;
+    }
+    std::unique_ptr<uint8_t[]> copy;
+    const uint8_t *number = numberStart(copy);
+    auto numberType = builtin::numberparsing::get_number_type(number);
+    if (numberType.error()) {
+        return numberType.error();
+    }
+    switch (numberType.value_unsafe()) {
+        case ondemand::number_type::signed_integer: {
+            auto result = builtin::numberparsing::parse_integer(number);
+            if (result.error()) {
+                return result.error();
+            }
+            if (result.value_unsafe() < 0) {
+                return NUMBER_OUT_OF_RANGE;
+            }
+            return uint64_t(result.value_unsafe());
+        }
+        case ondemand::number_type::unsigned_integer:
+            return builtin::numberparsing::parse_unsigned(number);
+        default:
+            return INCORRECT_TYPE;
+    }
+}
+
+template <>
+simdjson_result<double> JNTLazyValue::get<double>() const {
+    if (!JNTLazyIsNumberStart(JNTLazyChar(document, index))) {
+        return INCORRECT_TYPE;
+    }
+    std::unique_ptr<uint8_t[]> copy;
+    return builtin::numberparsing::parse_double(numberStart(copy));
+}
+
+template <>
+simdjson_result<bool> JNTLazyValue::get<bool>() const {
+    switch (JNTLazyChar(document, index)) {
+        case 't':
+            if (builtin::atomparsing::is_valid_true_atom(start(), remaining())) {
+                return true;
+            }
+            return INCORRECT_TYPE;
+        case 'f':
+            if (builtin::atomparsing::is_valid_false_atom(start(), remaining())) {
+                return false;
+            }
+            return INCORRECT_TYPE;
+        default:
+            return INCORRECT_TYPE;
+    }
+}
+
+template <>
+simdjson_result<const char *> JNTLazyValue::get<const char *>() const {
+    if (JNTLazyChar(document, index) != '"') {
+        return INCORRECT_TYPE;
+    }
+    const char *string = JNTLazyString(document, index);
+    if (!string) {
+        return STRING_ERROR;
+    }
+    return string;
+}
+
+template <>
+simdjson_result<std::string_view> JNTLazyValue::get<std::string_view>() const {
+    auto result = get<const char *>();
+    if (result.error()) {
+        return result.error();
+    }
+    return std::string_view(result.value_unsafe());
+}
+
+static simdjson_result<dom::element> JNTLazyFindValue(JNTLazyDocument *document, JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) {
+    uint32_t objectIndex = JNTLazyIndex(decoder.element);
+    if (JNTLazyChar(document, objectIndex) != '{') {
+        return simdjson_result<dom::element>(INCORRECT_TYPE);
+    }
+    uint32_t searchStart = JNTLazyIndex(*iteratorPtr);
+    uint32_t index = searchStart;
+    for (; JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+        if (JNTLazyKeyEquals(document, index, key)) {
+            decoder.context->stats.fieldsRead++;
+            *iteratorPtr = JNTLazyMake<JNTDictionaryIterator>(document, index);
+            return JNTLazyMake<dom::element>(document, index + 2);
+        }
+    }
+    if (JNT_UNLIKELY(JNTLazyChar(document, index) != '}')) {
+        JNTHandleMalformedJSON(decoder);
+        return simdjson_result<dom::element>(TAPE_ERROR);
+    }
+    // The key was out of order, so rewind to the start of the object
+    decoder.context->stats.rewinds++;
+    for (index = objectIndex + 1; index < searchStart && JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+        if (JNTLazyKeyEquals(document, index, key)) {
+            decoder.context->stats.fieldsRead++;
+            *iteratorPtr = JNTLazyMake<JNTDictionaryIterator>(document, index);
+            return JNTLazyMake<dom::element>(document, index + 2);
+        }
+    }
+    return simdjson_result<dom::element>(NO_SUCH_FIELD);
+}
+
+static NSInteger JNTLazyGetArrayCount(JNTLazyDocument *document, JNTDecoder decoder) {
+    NSInteger count = 0;
+    uint32_t index = JNTLazyIndex(decoder.element) + 1;
+    for (; JNTLazyIsElement(document, index); index = JNTLazyNextElement(document, index)) {
+        count++;
+    }
+    if (JNT_UNLIKELY(JNTLazyChar(document, index) != ']')) {
+        JNTHandleMalformedJSON(decoder);
+    }
+    return count;
+}
+
+// Stage 1 doesn't track nesting, so this holds the on-demand engine to the same limit as the DOM one, which (like here)
+// doesn't count empty containers
+static bool JNTLazyExceedsDepth(JNTLazyDocument *document, size_t maxDepth) {
+    size_t depth = 0;
+    for (uint32_t index = 0; index < document->structuralCount; index++) {
+        switch (uint8_t c = document->buf[document->structurals[index]]) {
+            case '{':
+            case '[':
+                if (index + 1 < document->structuralCount && document->buf[document->structurals[index + 1]] == c + 2) { // '}' or ']'
+                    index++;
+                } else if (++depth >= maxDepth) {
+                    return true;
+                }
+                break;
+            case '}':
+            case ']':
+                depth -= depth > 0;
+                break;
+        }
+    }
+    return false;
+}
+
+// Returns whether there are any non-ASCII chars in the dictionary keys, including ones that are escaped
+static bool JNTLazyHasNonASCIIKeys(JNTLazyDocument *document) {
+    // First check eight bytes at a time whether there are any non-ASCII chars or escapes anywhere. It's fine to read
+    // past the end, because the padding is zeroed
+    uint64_t high = 0;
+    uint64_t backslashes = 0;
+    for (size_t i = 0; i < document->length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, document->buf + i, sizeof(word));
+        high |= word;
+        uint64_t matches = word ^ 0x5C5C5C5C5C5C5C5CULL;
+        backslashes |= (matches - 0x0101010101010101ULL) & ~matches;
+    }
+    if (((high | backslashes) & 0x8080808080808080ULL) == 0) {
+        return false;
+    }
+    for (uint32_t index = 0; index + 1 < document->structuralCount; index++) {
+        if (!JNTLazyIsKey(document, index)) {
+            continue;
+        }
+        const uint8_t *raw = document->buf + document->structurals[index] + 1;
+        for (size_t i = 0; raw[i] != '"'; i++) {
+            if (raw[i] & 0x80) {
+                return true;
+            }
+            if (raw[i] == '\\') {
+                // Only \u0000 through \u007F are ASCII
+                if (raw[i + 1] == 'u' && !(raw[i + 2] == '0' && raw[i + 3] == '0' && '0' <= raw[i + 4] && raw[i + 4] <= '7')) {
+                    return true;
+                }
+                i++;
+            }
+        }
+    }
+    return false;
+}
+
 static inline bool JNTIsLower(char c) {
     return 'a' <= c && c <= 'z';
 }
@@ -225,7 +773,106 @@ static inline uint32_t JNTReplaceSnakeWithCamel(std::string &buffer, char *strin
     return size;
 }
 
+// Calls visitKey with each key (as a tape index) in the element and everything inside it. The tape is scanned in order
+// rather than recursed over, so deep documents don't need a deep stack; all it needs to track is, for each open object,
+// whether the next string is a key
+template <typename Visitor>
+static void JNTForEachKey(const dom::element &element, Visitor visitKey) {
+    const auto tape = (const internal::tape_ref *)&element;
+    const uint64_t *words = tape->doc->tape.get();
+    size_t index = tape->json_index;
+    size_t end = tape->after_element();
+    // For each open container: 0 for an array, 1 for an object expecting a value, 2 for one expecting a key
+    std::vector<uint8_t> expects;
+    while (index < end) {
+        auto type = (internal::tape_type)(words[index] >> 56);
+        if (type == internal::tape_type::END_OBJECT || type == internal::tape_type::END_ARRAY) {
+            expects.pop_back();
+            index++;
+            continue;
+        }
+        if (!expects.empty() && expects.back() != 0) {
+            if (expects.back() == 2) {
+                visitKey(index);
+                expects.back() = 1;
+                index++;
+                continue;
+            }
+            expects.back() = 2;
+        }
+        switch (type) {
+            case internal::tape_type::START_OBJECT:
+                expects.push_back(2);
+                index++;
+                break;
+            case internal::tape_type::START_ARRAY:
+                expects.push_back(0);
+                index++;
+                break;
+            case internal::tape_type::INT64:
+            case internal::tape_type::UINT64:
+            case internal::tape_type::DOUBLE:
+                index += 2;
+                break;
+            default:
+                index++;
+                break;
+        }
+    }
+}
+
+static inline char *JNTTapeString(const dom::element &element, size_t index) {
+    const auto tape = (const internal::tape_ref *)&element;
+    return (char *)internal::tape_ref(tape->doc, index).get_c_str();
+}
+
+static void JNTConvertAllSnakeToCamelHelper(const dom::element &element, std::string &buffer) {
+    JNTForEachKey(element, [&](size_t index) {
+        char *string = JNTTapeString(element, index);
+        uint32_t length = JNTReplaceSnakeWithCamel(buffer, string);
+        memcpy(string - sizeof(length), &length, sizeof(length));
+    });
+}
+
+// For shared documents, where converting one object at a time would race with other readers
+static void JNTConvertAllSnakeToCamel(JNTParsedDocument *parsedDocument) {
+    std::string buffer;
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(parsedDocument->root)) {
+        for (uint32_t index = 0; index + 1 < document->structuralCount; index++) {
+            if (JNTLazyIsKey(document, index)) {
+                char *string = (char *)JNTLazyString(document, index);
+                if (string) {
+                    JNTReplaceSnakeWithCamel(buffer, string);
+                }
+            }
+        }
+    } else if (parsedDocument->chunkedDocument) {
+        for (auto &chunk : parsedDocument->chunkedDocument->chunks) {
+            JNTConvertAllSnakeToCamelHelper(chunk->root, buffer);
+        }
+    } else {
+        JNTConvertAllSnakeToCamelHelper(parsedDocument->root, buffer);
+    }
+}
+
 void JNTConvertSnakeToCamel(JNTDecoder decoder) {
+    JNTParsedDocument *parsedDocument = decoder.context->document.get();
+    if (JNT_UNLIKELY(parsedDocument->shared.load(std::memory_order_relaxed))) {
+        std::call_once(parsedDocument->snakeCaseOnce, [parsedDocument] {
+            JNTConvertAllSnakeToCamel(parsedDocument);
+        });
+        return;
+    }
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element) + 1;
+        for (; JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+            char *string = (char *)JNTLazyString(document, index);
+            if (string) {
+                JNTReplaceSnakeWithCamel(decoder.context->snakeCaseBuffer, string);
+            }
+        }
+        return;
+    }
     dom::object object = decoder.element;
     for (auto it = object.begin(); it != object.end(); ++it) {
         char *string = (char *)it.key_c_str();
@@ -243,83 +890,1461 @@ static inline char JNTChecker(const char *s) {
     return has;
 }
 
-static inline char JNTCheckHelper(const dom::element &element) {
+static inline char JNTCheckHelper(const dom::element &element, uint64_t &keyCount) {
     char has = '\0';
-    if (element.is<dom::object>()) {
-        dom::object object = element;
-        for (auto [key, value] : object) {
-            has |= JNTChecker(key.data());
-            if (value.is<dom::object>() || value.is<dom::array>()) {
-                has |= JNTCheckHelper(value);
-            }
-        }
-    } else if (element.is<dom::array>()) {
-        dom::array array = element;
-        for (const auto member : array) {
-            if (member.is<dom::object>() || member.is<dom::array>()) {
-                has |= JNTCheckHelper(member);
-            }
-        }
-    }
+    JNTForEachKey(element, [&](size_t index) {
+        keyCount++;
+        has |= JNTChecker(JNTTapeString(element, index));
+    });
     return has;
 }
 
-// Check if there are any non-ASCII chars in the dictionary keys
-static inline bool JNTCheck(dom::element &element) {
-    return (JNTCheckHelper(element) & 0x80) != '\0';
+// Check if there are any non-ASCII chars in the dictionary keys, and count the keys while we're at it
+static inline bool JNTCheck(dom::element &element, uint64_t &keyCount) {
+    return (JNTCheckHelper(element, keyCount) & 0x80) != '\0';
 }
 
 ContextPointer JNTCreateContext(const char *originalString, uint32_t originalStringLength, const char *negInfString, const char *posInfString, const char *nanString, BOOL stringsForFloats) {
     return new JNTContext(originalString, originalStringLength, std::string(posInfString), std::string(negInfString), std::string(nanString), stringsForFloats);
 }
 
-static const uint64_t kDataLimit = (1ULL << 32) - 1;
+void JNTSetDecoderEngine(ContextPointer context, JNTDecoderEngine engine) {
+    context->engine = engine;
+}
 
-JNTDecoder JNTDocumentFromJSON(ContextPointer context, const void *data, NSInteger length, bool convertCase, const char * *retryReason, bool *success) {
-    *success = false;
-    if (length > kDataLimit) {
-        *retryReason = "The length of the JSON data is too long (see kDataLimit for the max)";
-        return JNTDecoderDefault();
-    }
-    simdjson::padded_string ps = simdjson::padded_string((char *)data, length);
-    auto result = context->parser.parse(ps);
-    if (result.error()) {
-        *retryReason = "Either the JSON is malformed, e.g. passing a number as the root object, or an integer was too large (couldn't fit in a 64-bit unsigned integer)";
-        return JNTDecoderDefault();
-    }
-    context->root = result.value();
-    if (JNTCheck(context->root)) {
-        *retryReason = "One or more keys had non-ASCII characters";
-        return JNTDecoderDefault();
-    } else {
-        *success = true;
-        return JNTCreateDecoder(context->root, context, 0);
-    }
+// Implementations
+//
+// simdjson has a kernel for each instruction set it's compiled for (e.g. icelake, haswell, westmere, arm64, fallback), and
+// picks the best one that the CPU supports the first time it's used. Overrides can be set for the process or a context,
+// e.g. to compare the kernels on the same machine, or to pin one
+
+static_assert(JNTInstructionSetNEON == internal::instruction_set::NEON, "");
+static_assert(JNTInstructionSetAVX2 == internal::instruction_set::AVX2, "");
+static_assert(JNTInstructionSetSSE42 == internal::instruction_set::SSE42, "");
+static_assert(JNTInstructionSetPCLMULQDQ == internal::instruction_set::PCLMULQDQ, "");
+static_assert(JNTInstructionSetBMI1 == internal::instruction_set::BMI1, "");
+static_assert(JNTInstructionSetBMI2 == internal::instruction_set::BMI2, "");
+static_assert(JNTInstructionSetAVX512F == internal::instruction_set::AVX512F, "");
+static_assert(JNTInstructionSetAVX512DQ == internal::instruction_set::AVX512DQ, "");
+static_assert(JNTInstructionSetAVX512CD == internal::instruction_set::AVX512CD, "");
+static_assert(JNTInstructionSetAVX512BW == internal::instruction_set::AVX512BW, "");
+static_assert(JNTInstructionSetAVX512VL == internal::instruction_set::AVX512VL, "");
+static_assert(JNTInstructionSetAVX512VBMI2 == internal::instruction_set::AVX512VBMI2, "");
+
+static const implementation *JNTActiveImplementation() {
+    // Until it's been used, the active implementation is a stand-in that detects the best one, so use it first
+    get_active_implementation()->name();
+    return get_active_implementation();
 }
 
-void JNTReleaseContext(JNTContext *context) {
-    delete context;
+static const implementation *JNTContextImplementation(ContextPointer context) {
+    return context->implementation ? context->implementation : JNTActiveImplementation();
 }
 
-static double JNTNumericValue(dom::element &element) {
-    if (element.is<double>()) {
-        return element.get<double>().value();
-    } else if (element.is<int64_t>()) {
-        return element.get<int64_t>().value();
-    } else if (element.is<uint64_t>()) {
-        return element.get<uint64_t>().value();
-    }
-    return 0;
+static void JNTFillImplementationInfo(const implementation *implementation, JNTImplementationInfo *info) {
+    info->name = implementation->name().c_str();
+    info->description = implementation->description().c_str();
+    info->requiredInstructionSets = implementation->required_instruction_sets();
+    info->supported = implementation->supported_by_runtime_system();
 }
 
-template <typename T, typename U>
-inline T JNTDocumentDecode(JNTDecoder decoder, dom::element element) {
-    simdjson_result<U> value = element.get<U>();
-    if (JNT_UNLIKELY(value.error())) {
-        BOOL elementIsNumeric = element.is<double>() || element.is<int64_t>() || element.is<uint64_t>();
-        if (std::is_integral<T>() && std::is_integral<U>() && elementIsNumeric) {
-            // If we asked for a number type, and simdjson complained strictly because it had a number of a type that
-            // couldn't be losslessly casted to the one we asked for, then the error is that the number doesn't fit
+// Whether the active implementation uses SIMD instructions, i.e. isn't the fallback one
+bool JNTHasVectorExtensions() {
+    return JNTActiveImplementation()->name() != "fallback";
+}
+
+JNTInstructionSet JNTGetDetectedInstructionSets() {
+    return internal::detect_supported_architectures();
+}
+
+// Returns how many implementations there are, and fills in up to infoCapacity of them
+NSInteger JNTGetImplementations(JNTImplementationInfo *infos, NSInteger infoCapacity) {
+    NSInteger count = 0;
+    for (const implementation *implementation : get_available_implementations()) {
+        if (count < infoCapacity) {
+            JNTFillImplementationInfo(implementation, &infos[count]);
+        }
+        count++;
+    }
+    return count;
+}
+
+// The one that the context's next parse will use, or the process-wide one if context is NULL
+void JNTGetActiveImplementation(ContextPointer context, JNTImplementationInfo *info) {
+    JNTFillImplementationInfo(context ? JNTContextImplementation(context) : JNTActiveImplementation(), info);
+}
+
+// For the context's future parses, or for the whole process if context is NULL. A NULL name goes back to the default,
+// which for a context is the process-wide implementation, and for the process is the best one the CPU supports. Returns
+// false if there's no such implementation or the CPU doesn't support it
+bool JNTSetImplementation(ContextPointer context, const char *name) {
+    const implementation *implementation = NULL;
+    if (name) {
+        implementation = get_available_implementations()[name];
+        if (!implementation || !implementation->supported_by_runtime_system()) {
+            return false;
+        }
+    }
+    if (context) {
+        context->implementation = implementation;
+    } else {
+        get_active_implementation() = implementation ? implementation : get_available_implementations().detect_best_supported();
+    }
+    return true;
+}
+
+// Parsers use the process-wide implementation unless they're given one before they're first allocated
+static error_code JNTAllocateParser(dom::parser &parser, const implementation *implementation, size_t capacity, size_t maxDepth) {
+    if (parser.capacity() == 0) {
+        return parser.allocate(capacity, maxDepth, implementation);
+    }
+    if (parser.capacity() < capacity || parser.max_depth() != maxDepth) {
+        return parser.allocate(std::max(parser.capacity(), capacity), maxDepth);
+    }
+    return SUCCESS;
+}
+
+static const uint64_t kDataLimit = (1ULL << 32) - 1;
+
+static bool JNTFeedBufferGrow(JNTFeedBuffer &feedBuffer, size_t capacity) {
+    if (capacity <= feedBuffer.capacity) {
+        return true;
+    }
+    uint8_t *data = new (std::nothrow) uint8_t[capacity + SIMDJSON_PADDING];
+    if (!data) {
+        return false;
+    }
+    if (feedBuffer.length > 0) {
+        memcpy(data, feedBuffer.data.get(), feedBuffer.length);
+    }
+    feedBuffer.data.reset(data);
+    feedBuffer.capacity = capacity;
+    return true;
+}
+
+static void JNTFinishDecodeStats(JNTContext *context);
+
+// Called before parsing anything into the context. If readers still share the current document, it's left to them.
+// A document that has ever been shared is never reused, even once its readers are gone, since converting keys and
+// unescaping strings are then done once for the whole document, and that's already happened
+static JNTParsedDocument *JNTMutableDocument(JNTContext *context) {
+    JNTFinishDecodeStats(context);
+    const implementation *implementation = JNTContextImplementation(context);
+    if (!context->document->implementation) {
+        context->document->implementation = implementation;
+    }
+    // Parsers keep the implementation they were created with, so switching means starting over with new ones
+    if (context->document.use_count() > 1 || context->document->shared.load() || context->document->implementation != implementation) {
+        JNTParsedDocument *document = context->document.get();
+        std::shared_ptr<JNTParsedDocument> newDocument = std::make_shared<JNTParsedDocument>(document->originalString, document->originalStringLength);
+        // Carry over anything fed for a document that hasn't been finished yet
+        if (document->feedBuffer.length > 0 && JNTFeedBufferGrow(newDocument->feedBuffer, document->feedBuffer.length)) {
+            memcpy(newDocument->feedBuffer.data.get(), document->feedBuffer.data.get(), document->feedBuffer.length);
+            newDocument->feedBuffer.length = document->feedBuffer.length;
+        }
+        newDocument->implementation = implementation;
+        context->document = newDocument;
+    }
+    return context->document.get();
+}
+
+// Points the document at the JSON about to be parsed into it, which DecimalString reads numbers from, and drops any file
+// or stream that an earlier parse left it holding
+static void JNTSetOriginalString(JNTParsedDocument *document, const char *data, uint64_t length) {
+    document->documentStream.reset();
+    document->mappedFile.reset();
+    document->originalString = data;
+    document->originalStringLength = (uint32_t)std::min<uint64_t>(length, kDataLimit);
+}
+
+// A context with its own error and scratch state that shares another context's document
+static JNTContext *JNTCreateSharingContext(JNTContext *context) {
+    JNTContext *sharingContext = new JNTContext(NULL, 0, context->posInfString, context->negInfString, context->nanString, context->stringsForFloats);
+    sharingContext->document = context->document;
+    sharingContext->engine = context->engine;
+    sharingContext->maxDepth = context->maxDepth;
+    return sharingContext;
+}
+
+static void JNTLazyMaterializeAll(JNTLazyDocument *document) {
+    for (uint32_t index = 0; index < document->structuralCount; index++) {
+        if (document->buf[document->structurals[index]] == '"') {
+            JNTLazyString(document, index);
+        }
+    }
+    document->frozen = true;
+}
+
+// Readers share the context's document, which stays alive until the context and all of its readers are released, and
+// can be used on other threads at the same time as the context and each other. All of them need to use the same key
+// decoding strategy. Documents from streams can't be shared
+ContextPointer JNTCreateReader(ContextPointer context) {
+    JNTParsedDocument *document = context->document.get();
+    if (document->documentStream) {
+        return NULL;
+    }
+    if (JNTLazyDocument *lazyDocument = JNTLazyDocumentFrom(document->root)) {
+        std::call_once(document->materializeOnce, [lazyDocument] {
+            JNTLazyMaterializeAll(lazyDocument);
+        });
+    }
+    document->shared.store(true);
+    return JNTCreateSharingContext(context);
+}
+
+JNTDecoder JNTReaderGetRoot(ContextPointer reader) {
+    return JNTCreateDecoder(reader->document->root, reader, 0);
+}
+
+// Adaptive engine selection
+//
+// Stats are kept per model type, across contexts. The on-demand engine wins when the host only reads a small part of
+// each document, but loses when it has to rewind to find keys that arrive out of order
+
+// On-demand decodes only count the fields present (which means walking every token) once every this many decodes
+static const uint64_t kJNTOnDemandSampleInterval = 8;
+static const double kJNTOnDemandMaxReadFraction = 0.5;
+static const double kJNTOnDemandMaxRewindFraction = 0.25;
+
+struct JNTModelTypeStats {
+    JNTDecoderEngineStats stats = {};
+    JNTDecoderEngine override = JNTDecoderEngineAutomatic;
+};
+
+static std::mutex sModelTypeStatsMutex;
+static std::unordered_map<const void *, JNTModelTypeStats> sModelTypeStats;
+
+static JNTDecoderEngine JNTChooseDecoderEngine(const JNTModelTypeStats &modelTypeStats) {
+    if (modelTypeStats.override != JNTDecoderEngineAutomatic) {
+        return modelTypeStats.override;
+    }
+    const JNTDecoderEngineStats &stats = modelTypeStats.stats;
+    if (stats.fieldsPresent == 0) {
+        return JNTDecoderEngineDOM;
+    }
+    double readFraction = (double)stats.fieldsRead / stats.fieldsPresent;
+    double rewindFraction = stats.lookups ? (double)stats.rewinds / stats.lookups : 0;
+    if (readFraction <= kJNTOnDemandMaxReadFraction && rewindFraction <= kJNTOnDemandMaxRewindFraction) {
+        return JNTDecoderEngineOnDemand;
+    }
+    return JNTDecoderEngineDOM;
+}
+
+void JNTSelectDecoderEngine(ContextPointer context, const void *modelType) {
+    // The last document's stats belong to the model type it was decoded as (this locks the mutex too)
+    JNTFinishDecodeStats(context);
+    std::lock_guard<std::mutex> lock(sModelTypeStatsMutex);
+    JNTModelTypeStats &modelTypeStats = sModelTypeStats[modelType];
+    context->modelType = modelType;
+    context->engine = JNTChooseDecoderEngine(modelTypeStats);
+    modelTypeStats.stats.nextEngine = context->engine;
+    context->stats.countsFieldsPresent = context->engine == JNTDecoderEngineDOM || modelTypeStats.stats.onDemandDecodeCount % kJNTOnDemandSampleInterval == 0;
+}
+
+void JNTSetDecoderEngineOverride(const void *modelType, JNTDecoderEngine engine) {
+    std::lock_guard<std::mutex> lock(sModelTypeStatsMutex);
+    JNTModelTypeStats &modelTypeStats = sModelTypeStats[modelType];
+    modelTypeStats.override = engine;
+    modelTypeStats.stats.nextEngine = JNTChooseDecoderEngine(modelTypeStats);
+}
+
+bool JNTGetDecoderEngineStats(const void *modelType, JNTDecoderEngineStats *stats) {
+    std::lock_guard<std::mutex> lock(sModelTypeStatsMutex);
+    auto it = sModelTypeStats.find(modelType);
+    if (it == sModelTypeStats.end()) {
+        return false;
+    }
+    *stats = it->second.stats;
+    return true;
+}
+
+static void JNTRecordDecodeStats(JNTContext *context) {
+    JNTDecodeStats &decodeStats = context->stats;
+    JNTLazyDocument *document = JNTLazyDocumentFrom(context->document->root);
+    if (document && decodeStats.countsFieldsPresent) {
+        decodeStats.fieldsPresent = 0;
+        for (uint32_t index = 0; index < document->structuralCount; index++) {
+            decodeStats.fieldsPresent += document->buf[document->structurals[index]] == ':';
+        }
+    }
+    std::lock_guard<std::mutex> lock(sModelTypeStatsMutex);
+    JNTModelTypeStats &modelTypeStats = sModelTypeStats[context->modelType];
+    JNTDecoderEngineStats &stats = modelTypeStats.stats;
+    stats.decodeCount++;
+    stats.onDemandDecodeCount += document != NULL;
+    stats.bytes += decodeStats.bytes;
+    stats.lookups += decodeStats.lookups;
+    stats.rewinds += decodeStats.rewinds;
+    if (decodeStats.countsFieldsPresent) {
+        stats.fieldsRead += decodeStats.fieldsRead;
+        stats.fieldsPresent += decodeStats.fieldsPresent;
+    }
+    stats.nextEngine = JNTChooseDecoderEngine(modelTypeStats);
+}
+
+// Records the stats of the last document parsed into the context, if they haven't been already, and starts over for the
+// next one. Whether to count the fields present is kept, since it's chosen before parsing
+static void JNTFinishDecodeStats(JNTContext *context) {
+    if (context->modelType && context->stats.parsed) {
+        JNTRecordDecodeStats(context);
+    }
+    bool countsFieldsPresent = context->stats.countsFieldsPresent;
+    context->stats = JNTDecodeStats();
+    context->stats.countsFieldsPresent = countsFieldsPresent;
+}
+
+// The parser that stage 1 runs on for the context's engine, with room for documents of at least capacity bytes
+static internal::dom_parser_implementation *JNTStage1Parser(JNTContext *context, size_t capacity) {
+    if (context->engine == JNTDecoderEngineOnDemand) {
+        if (!context->document->lazyDocument) {
+            context->document->lazyDocument.reset(new JNTLazyDocument());
+        }
+        JNTLazyDocument *document = context->document->lazyDocument.get();
+        if (!document->implementation || document->implementation->capacity() < capacity) {
+            if (context->document->implementation->create_dom_parser_implementation(capacity, context->maxDepth, document->implementation)) {
+                return NULL;
+            }
+        }
+        return document->implementation.get();
+    }
+    if (JNTAllocateParser(context->document->parser, context->document->implementation, capacity, context->maxDepth)) {
+        return NULL;
+    }
+    return context->document->parser.implementation.get();
+}
+
+// Runs stage 1 on whatever has been fed since it last ran, or on all of it if the parser has changed since (or has been
+// reallocated or used for something else, which abandons the document). With end, it also does the last block, which
+// needs the padding, and finishes
+static error_code JNTFeedBufferIndex(JNTContext *context, bool end) {
+    JNTFeedBuffer &feedBuffer = context->document->feedBuffer;
+    internal::dom_parser_implementation *parser = JNTStage1Parser(context, feedBuffer.capacity);
+    if (!parser) {
+        return MEMALLOC;
+    }
+    const uint8_t *buf = feedBuffer.data.get();
+    error_code error = UNINITIALIZED;
+    if (feedBuffer.indexer == parser && parser->validate_utf8 == !context->trusted) {
+        error = end ? parser->stage1_end(buf, feedBuffer.length) : parser->stage1_next(buf, feedBuffer.length);
+    }
+    if (error == UNINITIALIZED) {
+        parser->validate_utf8 = !context->trusted;
+        feedBuffer.indexer = parser;
+        error = parser->stage1_start();
+        if (!error) {
+            error = end ? parser->stage1_end(buf, feedBuffer.length) : parser->stage1_next(buf, feedBuffer.length);
+        }
+    }
+    return error;
+}
+
+// buf must be writable, since strings are unescaped in place, and padded with SIMDJSON_PADDING bytes. If fed, it's the
+// feed buffer, which stage 1 only needs finishing on
+static JNTDecoder JNTLazyDocumentFromBuffer(ContextPointer context, uint8_t *buf, size_t length, bool fed, const char * *retryReason, bool *success) {
+    context->document->chunkedDocument.reset();
+    if (!context->document->lazyDocument) {
+        context->document->lazyDocument.reset(new JNTLazyDocument());
+    }
+    JNTLazyDocument *document = context->document->lazyDocument.get();
+    document->frozen = false;
+    error_code error = SUCCESS;
+    if (fed) {
+        error = JNTFeedBufferIndex(context, true);
+    } else {
+        if (!document->implementation || document->implementation->capacity() < length) {
+            error = context->document->implementation->create_dom_parser_implementation(length, context->maxDepth, document->implementation);
+        }
+        if (!error) {
+            document->implementation->validate_utf8 = !context->trusted;
+            error = document->implementation->stage1(buf, length, stage1_mode::regular);
+        }
+    }
+    if (error) {
+        *retryReason = "Either the JSON is malformed or not valid UTF-8, or there was not enough memory to index it";
+        return JNTDecoderDefault();
+    }
+    document->buf = buf;
+    document->length = length;
+    document->structurals = document->implementation->structural_indexes.get();
+    document->structuralCount = document->implementation->n_structural_indexes;
+    document->materialized.assign(document->structuralCount, false);
+    if (JNTLazyExceedsDepth(document, context->maxDepth)) {
+        *retryReason = "The JSON was nested too deeply";
+        return JNTDecoderDefault();
+    }
+    if (!context->trusted && JNTLazyHasNonASCIIKeys(document)) {
+        *retryReason = "One or more keys had non-ASCII characters";
+        return JNTDecoderDefault();
+    }
+    context->document->root = JNTLazyMake<dom::element>(document, 0);
+    context->stats.parsed = true;
+    context->stats.bytes = length;
+    *success = true;
+    return JNTCreateDecoder(context->document->root, context, 0);
+}
+
+static JNTDecoder JNTLazyDocumentFromJSON(ContextPointer context, const void *data, NSInteger length, const char * *retryReason, bool *success) {
+    if (!context->document->lazyDocument) {
+        context->document->lazyDocument.reset(new JNTLazyDocument());
+    }
+    JNTLazyDocument *document = context->document->lazyDocument.get();
+    document->json = simdjson::padded_string((char *)data, length);
+    return JNTLazyDocumentFromBuffer(context, (uint8_t *)document->json.data(), length, false, retryReason, success);
+}
+
+// buf must be padded with SIMDJSON_PADDING bytes. If fed, it's the feed buffer, which stage 1 only needs finishing on
+static JNTDecoder JNTDocumentFromBuffer(ContextPointer context, const uint8_t *buf, size_t length, bool fed, const char * *retryReason, bool *success) {
+    context->document->chunkedDocument.reset();
+    simdjson_result<dom::element> result;
+    if (fed) {
+        error_code error = JNTFeedBufferIndex(context, true);
+        result = error ? simdjson_result<dom::element>(error) : context->document->parser.parse_indexed(length);
+    } else {
+        if (JNTAllocateParser(context->document->parser, context->document->implementation, length, context->maxDepth)) {
+            *retryReason = "There was not enough memory to parse the JSON";
+            return JNTDecoderDefault();
+        }
+        context->document->parser.set_utf8_validation(!context->trusted);
+        result = context->document->parser.parse(buf, length, false);
+    }
+    if (result.error() == MEMALLOC) {
+        *retryReason = "There was not enough memory to parse the JSON";
+        return JNTDecoderDefault();
+    }
+    if (result.error()) {
+        *retryReason = "Either the JSON is malformed, e.g. passing a number as the root object, or an integer was too large (couldn't fit in a 64-bit unsigned integer)";
+        return JNTDecoderDefault();
+    }
+    context->document->root = result.value();
+    context->stats.fieldsPresent = 0;
+    context->stats.countsFieldsPresent = !context->trusted;
+    if (!context->trusted && JNTCheck(context->document->root, context->stats.fieldsPresent)) {
+        *retryReason = "One or more keys had non-ASCII characters";
+        return JNTDecoderDefault();
+    } else {
+        context->stats.parsed = true;
+        context->stats.bytes = length;
+        *success = true;
+        return JNTCreateDecoder(context->document->root, context, 0);
+    }
+}
+
+// Large documents
+//
+// A top-level array that's too long for simdjson (which uses 32-bit offsets) is split at commas between its elements
+// into chunks of about this size, each parsed as an array of its own
+static const uint64_t kJNTArrayChunkSize = 1ULL << 30;
+
+static inline size_t JNTSkipWhitespace(const uint8_t *buf, size_t index, size_t length) {
+    while (index < length && (buf[index] == ' ' || buf[index] == '\n' || buf[index] == '\r' || buf[index] == '\t')) {
+        index++;
+    }
+    return index;
+}
+
+// Finds the opening bracket of the top-level array, the commas to split at, and the closing bracket. This only tracks
+// strings and depth, and leaves validation to the parsers of the chunks
+static bool JNTFindArraySplits(const uint8_t *buf, size_t length, size_t chunkSize, std::vector<size_t> &splits) {
+    size_t index = JNTSkipWhitespace(buf, 0, length);
+    if (index == length || buf[index] != '[') {
+        return false;
+    }
+    splits.push_back(index);
+    size_t depth = 1;
+    size_t nextSplit = index + chunkSize;
+    for (index++; index < length; index++) {
+        switch (buf[index]) {
+            case '"': {
+                // Skip to the closing quote, i.e. one not preceded by an odd number of backslashes
+                size_t start = index + 1;
+                while (true) {
+                    const uint8_t *quote = (const uint8_t *)memchr(buf + start, '"', length - start);
+                    if (!quote) {
+                        return false;
+                    }
+                    index = quote - buf;
+                    size_t backslash = index;
+                    while (backslash > start && buf[backslash - 1] == '\\') {
+                        backslash--;
+                    }
+                    if ((index - backslash) % 2 == 0) {
+                        break;
+                    }
+                    start = index + 1;
+                }
+                break;
+            }
+            case '[':
+            case '{':
+                depth++;
+                break;
+            case ']':
+            case '}':
+                depth--;
+                if (depth == 0) {
+                    splits.push_back(index);
+                    return JNTSkipWhitespace(buf, index + 1, length) == length;
+                }
+                break;
+            case ',':
+                if (depth == 1 && index >= nextSplit) {
+                    splits.push_back(index);
+                    nextSplit = index + chunkSize;
+                }
+                break;
+        }
+    }
+    return false;
+}
+
+static bool JNTParseArrayChunk(JNTArrayChunk *chunk, const implementation *implementation, bool trusted, size_t maxDepth, const uint8_t *buf, size_t start, size_t end) {
+    size_t length = end - start + 1;
+    chunk->json = padded_string(length + 2);
+    char *data = chunk->json.data();
+    data[0] = '[';
+    memcpy(data + 1, buf + start, length);
+    data[length + 1] = ']';
+    if (JNTAllocateParser(chunk->parser, implementation, length + 2, maxDepth)) {
+        return false;
+    }
+    chunk->parser.set_utf8_validation(!trusted);
+    auto result = chunk->parser.parse((const uint8_t *)data, length + 2, false);
+    if (result.error() || result.value_unsafe().get(chunk->array)) {
+        return false;
+    }
+    chunk->root = result.value_unsafe();
+    uint64_t keyCount = 0;
+    if (!trusted && JNTCheck(chunk->root, keyCount)) {
+        return false;
+    }
+    chunk->count = chunk->array.size();
+    // The count on the tape saturates at 24 bits
+    if (chunk->count == 0xFFFFFF) {
+        chunk->count = 0;
+        for (auto it = chunk->array.begin(); it != chunk->array.end(); ++it) {
+            chunk->count++;
+        }
+    }
+    return true;
+}
+
+// The chunks are parsed concurrently, one parser each, when there's more than one of them
+static JNTDecoder JNTChunkedDocumentFromSplits(ContextPointer context, const uint8_t *buf, size_t length, const std::vector<size_t> &splits, const char * *retryReason, bool *success) {
+    context->document->chunkedDocument.reset(new JNTChunkedDocument());
+    JNTChunkedDocument *chunkedDocument = context->document->chunkedDocument.get();
+    size_t chunkCount = splits.size() - 1;
+    for (size_t i = 0; i < chunkCount; i++) {
+        // Everything between the brackets or commas on either side
+        if (splits[i + 1] - splits[i] - 1 > kDataLimit - 2) {
+            *retryReason = "An element of the top-level array is too long (see kDataLimit for the max)";
+            return JNTDecoderDefault();
+        }
+        chunkedDocument->chunks.emplace_back(new JNTArrayChunk());
+    }
+    // dispatch_apply returns once every chunk is done, so the block can point to things on the stack
+    std::atomic<bool> failed(false);
+    std::atomic<bool> *failedPtr = &failed;
+    const std::vector<size_t> *splitsPtr = &splits;
+    const implementation *implementation = context->document->implementation;
+    bool trusted = context->trusted;
+    size_t maxDepth = context->maxDepth;
+    dispatch_apply(chunkCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t i) {
+        if (!JNTParseArrayChunk(chunkedDocument->chunks[i].get(), implementation, trusted, maxDepth, buf, (*splitsPtr)[i] + 1, (*splitsPtr)[i + 1] - 1)) {
+            failedPtr->store(true);
+        }
+    });
+    if (failed.load()) {
+        *retryReason = "Either the JSON is malformed, an integer was too large, or one or more keys had non-ASCII characters";
+        return JNTDecoderDefault();
+    }
+    for (auto &chunk : chunkedDocument->chunks) {
+        // A chunk can only be empty if it's the whole array, otherwise there was an extra comma
+        if (chunk->count == 0 && chunkCount > 1) {
+            *retryReason = "The JSON is malformed";
+            return JNTDecoderDefault();
+        }
+        chunk->firstElement = chunkedDocument->count;
+        chunkedDocument->count += chunk->count;
+    }
+    auto result = chunkedDocument->rootParser.parse("[]", 2);
+    if (result.error()) {
+        *retryReason = "There was not enough memory to parse the JSON";
+        return JNTDecoderDefault();
+    }
+    chunkedDocument->root = result.value_unsafe();
+    context->document->root = chunkedDocument->root;
+    context->stats.parsed = true;
+    context->stats.bytes = length;
+    *success = true;
+    return JNTCreateDecoder(context->document->root, context, 0);
+}
+
+static JNTDecoder JNTChunkedDocumentFromBuffer(ContextPointer context, const uint8_t *buf, size_t length, const char * *retryReason, bool *success) {
+    std::vector<size_t> splits;
+    if (!JNTFindArraySplits(buf, length, kJNTArrayChunkSize, splits)) {
+        *retryReason = "The JSON is too long (see kDataLimit for the max) and is not a well-formed top-level array that could be split";
+        return JNTDecoderDefault();
+    }
+    return JNTChunkedDocumentFromSplits(context, buf, length, splits, retryReason, success);
+}
+
+// For input that's known to be valid UTF-8 JSON with ASCII keys, e.g. from the host's own services. Stage 1 doesn't
+// validate UTF-8, and keys aren't checked for non-ASCII characters (so DOM decodes don't count the fields present for the
+// engine stats either). The structure is still fully validated
+void JNTSetTrustedInput(ContextPointer context, bool trusted) {
+    context->trusted = trusted;
+}
+
+// Containers can be nested up to maxDepth - 1 deep, as with simdjson's max_depth. Deeper documents fail to parse. Returns
+// false if maxDepth is less than 1
+bool JNTSetMaxDepth(ContextPointer context, NSInteger maxDepth) {
+    if (maxDepth < 1) {
+        return false;
+    }
+    context->maxDepth = maxDepth;
+    return true;
+}
+
+void JNTSetParallelParsing(ContextPointer context, NSInteger rangeCount, NSInteger minimumLength) {
+    context->parallelRangeCount = rangeCount > 1 ? rangeCount : 0;
+    context->parallelMinimumLength = minimumLength;
+}
+
+// Splits a large top-level array into one range per thread. Anything else is left to the regular parse
+static bool JNTFindParallelSplits(ContextPointer context, const uint8_t *buf, size_t length, std::vector<size_t> &splits) {
+    if (context->parallelRangeCount == 0 || length < (size_t)context->parallelMinimumLength || context->engine == JNTDecoderEngineOnDemand) {
+        return false;
+    }
+    size_t index = JNTSkipWhitespace(buf, 0, length);
+    if (index == length || buf[index] != '[') {
+        return false;
+    }
+    size_t chunkSize = std::min<size_t>(length / context->parallelRangeCount + 1, kJNTArrayChunkSize);
+    return JNTFindArraySplits(buf, length, chunkSize, splits) && splits.size() > 2;
+}
+
+JNTDecoder JNTDocumentFromJSON(ContextPointer context, const void *data, NSInteger length, bool convertCase, const char * *retryReason, bool *success) {
+    JNTSetOriginalString(JNTMutableDocument(context), (const char *)data, length);
+    *success = false;
+    if (length > kDataLimit) {
+        return JNTChunkedDocumentFromBuffer(context, (const uint8_t *)data, length, retryReason, success);
+    }
+    std::vector<size_t> splits;
+    if (JNTFindParallelSplits(context, (const uint8_t *)data, length, splits)) {
+        return JNTChunkedDocumentFromSplits(context, (const uint8_t *)data, length, splits, retryReason, success);
+    }
+    if (context->engine == JNTDecoderEngineOnDemand) {
+        return JNTLazyDocumentFromJSON(context, data, length, retryReason, success);
+    }
+    simdjson::padded_string ps = simdjson::padded_string((char *)data, length);
+    return JNTDocumentFromBuffer(context, (const uint8_t *)ps.data(), length, false, retryReason, success);
+}
+
+// Maps the file with enough zeroed padding after it that simdjson can read it in place. The mapping is private, so the
+// on-demand engine, which unescapes strings in place, gets copy-on-write pages and never touches the file itself
+static bool JNTMapFile(JNTMappedFile *mappedFile, const char *path, bool writable, const char * *retryReason) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *retryReason = "The file could not be opened";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        *retryReason = "The file could not be read";
+        return false;
+    }
+    size_t length = (size_t)info.st_size;
+    size_t pageSize = (size_t)getpagesize();
+    size_t fileMappedLength = (length + pageSize - 1) / pageSize * pageSize;
+    size_t mappedLength = (length + SIMDJSON_PADDING + pageSize - 1) / pageSize * pageSize;
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    // Reserve the whole range with anonymous (zeroed) pages, then put the file over the start of it
+    void *base = mmap(NULL, mappedLength, protection, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        *retryReason = "There was not enough memory to map the file";
+        return false;
+    }
+    if (fileMappedLength > 0 && mmap(base, fileMappedLength, protection, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, mappedLength);
+        close(fd);
+        *retryReason = "The file could not be mapped";
+        return false;
+    }
+    close(fd);
+    madvise(base, mappedLength, MADV_SEQUENTIAL);
+    madvise(base, fileMappedLength, MADV_WILLNEED);
+    mappedFile->base = base;
+    mappedFile->mappedLength = mappedLength;
+    mappedFile->length = length;
+    return true;
+}
+
+JNTDecoder JNTDocumentFromFile(ContextPointer context, const char *path, bool convertCase, const char * *retryReason, bool *success) {
+    JNTMutableDocument(context);
+    *success = false;
+    bool onDemand = context->engine == JNTDecoderEngineOnDemand;
+    std::unique_ptr<JNTMappedFile> mappedFile(new JNTMappedFile());
+    if (!JNTMapFile(mappedFile.get(), path, onDemand, retryReason)) {
+        return JNTDecoderDefault();
+    }
+    // Keep the mapping alive for as long as the context, since strings and DecimalString can point into it
+    JNTSetOriginalString(context->document.get(), (const char *)mappedFile->base, mappedFile->length);
+    context->document->mappedFile = std::move(mappedFile);
+    uint8_t *buf = (uint8_t *)context->document->mappedFile->base;
+    size_t length = context->document->mappedFile->length;
+    if (length > kDataLimit) {
+        return JNTChunkedDocumentFromBuffer(context, buf, length, retryReason, success);
+    }
+    std::vector<size_t> splits;
+    if (JNTFindParallelSplits(context, buf, length, splits)) {
+        return JNTChunkedDocumentFromSplits(context, buf, length, splits, retryReason, success);
+    }
+    if (onDemand) {
+        return JNTLazyDocumentFromBuffer(context, buf, length, false, retryReason, success);
+    }
+    return JNTDocumentFromBuffer(context, buf, length, false, retryReason, success);
+}
+
+// Streams always use the DOM engine. Each document returned by JNTDocumentStreamNext is only valid until the next call.
+// With more than one thread (the default, with threadCount 0), stage 1 of the next batch runs on a worker thread while
+// the current batch is decoded. simdjson only ever uses one worker, so anything above 2 is the same as 2
+bool JNTDocumentStreamFromJSON(ContextPointer context, const void *data, NSInteger length, size_t batchSize, size_t threadCount, const char * *retryReason) {
+    JNTMutableDocument(context);
+    if (batchSize == 0) {
+        batchSize = dom::DEFAULT_BATCH_SIZE;
+    }
+    // Number locations are 32-bit offsets from the start of the batch
+    if (batchSize > kDataLimit) {
+        *retryReason = "The batch size is too large (see kDataLimit for the max)";
+        return false;
+    }
+    // Stops and joins the worker of any previous stream. Each document sets the original string when it's reached
+    JNTSetOriginalString(context->document.get(), NULL, 0);
+    context->document->chunkedDocument.reset();
+#ifdef SIMDJSON_THREADS_ENABLED
+    context->document->parser.threaded = threadCount != 1;
+#endif
+    if (JNTAllocateParser(context->document->parser, context->document->implementation, batchSize, context->maxDepth)) {
+        *retryReason = "There was not enough memory to parse the stream";
+        return false;
+    }
+    context->document->parser.set_utf8_validation(!context->trusted);
+    simdjson::padded_string json = simdjson::padded_string((char *)data, length);
+    // The stream points into the padded string's buffer, which stays put when the string is moved
+    auto result = context->document->parser.parse_many((const uint8_t *)json.data(), length, batchSize);
+    if (result.error()) {
+        *retryReason = "There was not enough memory to parse the stream";
+        return false;
+    }
+    context->document->documentStream.reset(new JNTDocumentStream(std::move(json), std::move(result).value_unsafe()));
+    return true;
+}
+
+JNTDecoder JNTDocumentStreamNext(ContextPointer context, size_t *offset, bool *isAtEnd, const char * *retryReason, bool *success) {
+    *success = false;
+    *isAtEnd = false;
+    JNTDocumentStream *documentStream = context->document->documentStream.get();
+    if (!documentStream) {
+        *isAtEnd = true;
+        return JNTDecoderDefault();
+    }
+    if (!documentStream->started) {
+        documentStream->iterator = documentStream->stream.begin();
+        documentStream->started = true;
+    } else {
+        ++documentStream->iterator;
+    }
+    if (!(documentStream->iterator != documentStream->stream.end())) {
+        *isAtEnd = true;
+        return JNTDecoderDefault();
+    }
+    auto result = *documentStream->iterator;
+    *offset = documentStream->iterator.current_index();
+    if (result.error()) {
+        *retryReason = "Either the JSON is malformed, e.g. passing a number as the root object, or an integer was too large (couldn't fit in a 64-bit unsigned integer)";
+        return JNTDecoderDefault();
+    }
+    size_t batchStart = documentStream->iterator.current_batch_start();
+    context->document->originalString = documentStream->json.data() + batchStart;
+    context->document->originalStringLength = (uint32_t)std::min<uint64_t>(documentStream->json.size() - batchStart, kDataLimit);
+    context->document->root = result.value_unsafe();
+    uint64_t keyCount = 0;
+    if (!context->trusted && JNTCheck(context->document->root, keyCount)) {
+        *retryReason = "One or more keys had non-ASCII characters";
+        return JNTDecoderDefault();
+    }
+    *success = true;
+    return JNTCreateDecoder(context->document->root, context, 0);
+}
+
+// Incremental parsing
+//
+// Chunks are appended straight into a padded buffer owned by the context, and JNTParserFinish parses it in place, so the
+// host doesn't need to assemble the body itself and there's no copy at the end. Stage 1 runs on each 64-byte block as
+// soon as it's complete, so by the time the last chunk arrives only its last block and stage 2 are left. When the
+// length is known up front (e.g. from Content-Length), JNTParserReserve also allocates the parser's buffers while the
+// rest of the data is in flight. Otherwise they grow with the buffer, and stage 1 starts over whenever they do
+
+bool JNTParserReserve(ContextPointer context, NSInteger expectedLength) {
+    JNTMutableDocument(context);
+    if (expectedLength < 0 || (uint64_t)expectedLength > kDataLimit) {
+        return false;
+    }
+    if (!JNTFeedBufferGrow(context->document->feedBuffer, expectedLength)) {
+        return false;
+    }
+    return JNTStage1Parser(context, context->document->feedBuffer.capacity) != NULL;
+}
+
+bool JNTParserFeed(ContextPointer context, const void *chunk, NSInteger length) {
+    JNTMutableDocument(context);
+    JNTFeedBuffer &feedBuffer = context->document->feedBuffer;
+    uint64_t newLength = feedBuffer.length + (uint64_t)length;
+    if (length < 0 || newLength > kDataLimit) {
+        return false;
+    }
+    if (newLength > feedBuffer.capacity && !JNTFeedBufferGrow(feedBuffer, std::max<size_t>(newLength, std::min<uint64_t>(feedBuffer.capacity * 2, kDataLimit)))) {
+        return false;
+    }
+    memcpy(feedBuffer.data.get() + feedBuffer.length, chunk, length);
+    feedBuffer.length = newLength;
+    // Anything that can't be indexed now (e.g. for lack of memory) is left for JNTParserFinish
+    JNTFeedBufferIndex(context, false);
+    return true;
+}
+
+// The buffer stays alive until the next feed after this, or until the context is released
+JNTDecoder JNTParserFinish(ContextPointer context, bool convertCase, const char * *retryReason, bool *success) {
+    JNTMutableDocument(context);
+    *success = false;
+    JNTFeedBuffer &feedBuffer = context->document->feedBuffer;
+    // Even if nothing was fed, there needs to be a buffer for the padding
+    if (!feedBuffer.data && !JNTFeedBufferGrow(feedBuffer, 1)) {
+        *retryReason = "There was not enough memory to parse the JSON";
+        return JNTDecoderDefault();
+    }
+    size_t length = feedBuffer.length;
+    uint8_t *buf = feedBuffer.data.get();
+    memset(buf + length, 0, SIMDJSON_PADDING);
+    JNTSetOriginalString(context->document.get(), (const char *)buf, length);
+    JNTDecoder decoder;
+    if (context->engine == JNTDecoderEngineOnDemand) {
+        decoder = JNTLazyDocumentFromBuffer(context, buf, length, true, retryReason, success);
+    } else {
+        decoder = JNTDocumentFromBuffer(context, buf, length, true, retryReason, success);
+    }
+    // Let the next feed start a new document, without giving up the buffer
+    feedBuffer.length = 0;
+    feedBuffer.indexer = NULL;
+    return decoder;
+}
+
+// Feeds the segments one after another, so stage 1 runs on each block as it's gathered into the feed buffer, while it's
+// still in cache. The buffer and parser are sized for all of them first, so stage 1 never has to start over. Stage 2 and
+// the decoders read values straight from the JSON, which therefore has to be contiguous (and writable, on demand), so
+// gathering it is the one copy that can't be avoided
+JNTDecoder JNTDocumentFromSegments(ContextPointer context, const JNTSegment *segments, NSInteger count, bool convertCase, const char * *retryReason, bool *success) {
+    JNTMutableDocument(context);
+    *success = false;
+    uint64_t length = 0;
+    for (NSInteger i = 0; i < count; i++) {
+        length += segments[i].length;
+    }
+    context->document->feedBuffer.length = 0;
+    context->document->feedBuffer.indexer = NULL;
+    if (length > kDataLimit) {
+        *retryReason = "The length of the JSON data is too long (see kDataLimit for the max)";
+        return JNTDecoderDefault();
+    }
+    if (!JNTParserReserve(context, length)) {
+        *retryReason = "There was not enough memory to parse the JSON";
+        return JNTDecoderDefault();
+    }
+    for (NSInteger i = 0; i < count; i++) {
+        if (!JNTParserFeed(context, segments[i].data, segments[i].length)) {
+            context->document->feedBuffer.length = 0;
+            *retryReason = "There was not enough memory to parse the JSON";
+            return JNTDecoderDefault();
+        }
+    }
+    return JNTParserFinish(context, convertCase, retryReason, success);
+}
+
+// Batches
+//
+// Many small, independent documents (e.g. responses from a number of backends) parsed in one call. The ith document goes
+// into contexts[i], and the contexts are meant to come from a pool that's passed to every batch, so each one's parser
+// and padded copy of the JSON are allocated once and reused rather than set up per document
+
+static JNTDecoder JNTDocumentFromBatchEntry(ContextPointer context, const JNTSegment &segment, bool convertCase, const char * *retryReason, bool *success) {
+    // Pooled contexts can still have an error from decoding their previous document
+    JNTClearError(context);
+    if ((uint64_t)segment.length > kDataLimit) {
+        return JNTDocumentFromJSON(context, segment.data, segment.length, convertCase, retryReason, success);
+    }
+    // Copies it into the context's feed buffer, which only grows
+    return JNTDocumentFromSegments(context, &segment, 1, convertCase, retryReason, success);
+}
+
+// Returns true if every document parsed. Otherwise, successes and retryReasons say which failed and why. With a
+// threadCount above 1, up to that many threads take documents in order until there are none left. Anything fed to one
+// of the contexts but not yet finished is discarded
+bool JNTDocumentsFromJSONBatch(ContextPointer *contexts, const JNTSegment *documents, NSInteger count, NSInteger threadCount, bool convertCase, JNTDecoder *roots, const char * *retryReasons, bool *successes) {
+    for (NSInteger i = 0; i < count; i++) {
+        retryReasons[i] = NULL;
+    }
+    threadCount = std::min(threadCount, count);
+    if (threadCount <= 1) {
+        bool allSucceeded = true;
+        for (NSInteger i = 0; i < count; i++) {
+            roots[i] = JNTDocumentFromBatchEntry(contexts[i], documents[i], convertCase, &retryReasons[i], &successes[i]);
+            allSucceeded &= successes[i];
+        }
+        return allSucceeded;
+    }
+    // dispatch_apply returns once every thread is done, so the block can point to things on the stack
+    std::atomic<NSInteger> next(0);
+    std::atomic<bool> failed(false);
+    std::atomic<NSInteger> *nextPtr = &next;
+    std::atomic<bool> *failedPtr = &failed;
+    dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread) {
+        for (NSInteger i = nextPtr->fetch_add(1); i < count; i = nextPtr->fetch_add(1)) {
+            roots[i] = JNTDocumentFromBatchEntry(contexts[i], documents[i], convertCase, &retryReasons[i], &successes[i]);
+            if (!successes[i]) {
+                failedPtr->store(true);
+            }
+        }
+    });
+    return !failed.load();
+}
+
+// Pipelines
+//
+// For a stream of payloads, a worker thread parses the next ones into free contexts while the host decodes the current
+// one. Each context goes back into the ring when the host recycles it, and the number of contexts bounds how many
+// payloads can be in flight, so submitting blocks when the host falls behind. Two contexts make it double-buffered
+
+struct JNTPipelinePayload {
+    const void *data;
+    NSInteger length;
+    ContextPointer context;
+    JNTDecoder root;
+    const char *retryReason = NULL;
+    bool success = false;
+};
+
+struct JNTPipeline {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<ContextPointer> freeContexts;
+    // In the order they were submitted. The first parsedCount of them have been parsed
+    std::deque<JNTPipelinePayload> payloads;
+    size_t parsedCount = 0;
+    bool convertCase;
+    bool finished = false;
+    bool cancelled = false;
+    std::thread worker;
+
+    JNTPipeline(ContextPointer *contexts, NSInteger contextCount, bool convertCase) : freeContexts(contexts, contexts + contextCount), convertCase(convertCase) {
+    }
+};
+
+static void JNTPipelineRun(JNTPipeline *pipeline) {
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    while (true) {
+        pipeline->changed.wait(lock, [pipeline] {
+            return pipeline->cancelled || pipeline->finished || pipeline->parsedCount < pipeline->payloads.size();
+        });
+        if (pipeline->cancelled || pipeline->parsedCount == pipeline->payloads.size()) {
+            return;
+        }
+        // References to the elements of a deque survive pushes onto the back, and the host only pops parsed ones
+        JNTPipelinePayload &payload = pipeline->payloads[pipeline->parsedCount];
+        lock.unlock();
+        JNTSegment segment = {payload.data, payload.length};
+        payload.root = JNTDocumentFromBatchEntry(payload.context, segment, pipeline->convertCase, &payload.retryReason, &payload.success);
+        lock.lock();
+        pipeline->parsedCount++;
+        pipeline->changed.notify_all();
+    }
+}
+
+// The pipeline doesn't own the contexts, which can be released after the pipeline is
+PipelinePointer JNTPipelineCreate(ContextPointer *contexts, NSInteger contextCount, bool convertCase) {
+    if (contextCount < 1) {
+        return NULL;
+    }
+    JNTPipeline *pipeline = new JNTPipeline(contexts, contextCount, convertCase);
+    pipeline->worker = std::thread(JNTPipelineRun, pipeline);
+    return pipeline;
+}
+
+// Blocks until there's a free context, and returns false if the pipeline was cancelled. The data needs to stay valid
+// until JNTPipelineNext returns it
+bool JNTPipelineSubmit(PipelinePointer pipeline, const void *data, NSInteger length) {
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    pipeline->changed.wait(lock, [pipeline] {
+        return pipeline->cancelled || pipeline->finished || !pipeline->freeContexts.empty();
+    });
+    if (pipeline->cancelled || pipeline->finished) {
+        return false;
+    }
+    JNTPipelinePayload payload;
+    payload.data = data;
+    payload.length = length;
+    payload.context = pipeline->freeContexts.back();
+    pipeline->freeContexts.pop_back();
+    pipeline->payloads.push_back(payload);
+    pipeline->changed.notify_all();
+    return true;
+}
+
+// No more payloads will be submitted. JNTPipelineNext returns the ones already submitted and then reports the end
+void JNTPipelineFinish(PipelinePointer pipeline) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    pipeline->finished = true;
+    pipeline->changed.notify_all();
+}
+
+// Blocks until the next payload, in submission order, has been parsed. The host owns the returned context until it
+// passes it to JNTPipelineRecycle
+JNTDecoder JNTPipelineNext(PipelinePointer pipeline, ContextPointer *context, bool *isAtEnd, const char * *retryReason, bool *success) {
+    *success = false;
+    *isAtEnd = false;
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    pipeline->changed.wait(lock, [pipeline] {
+        return pipeline->cancelled || pipeline->parsedCount > 0 || (pipeline->finished && pipeline->payloads.empty());
+    });
+    if (pipeline->parsedCount == 0) {
+        *isAtEnd = true;
+        return JNTDecoderDefault();
+    }
+    JNTPipelinePayload payload = pipeline->payloads.front();
+    pipeline->payloads.pop_front();
+    pipeline->parsedCount--;
+    *context = payload.context;
+    *success = payload.success;
+    if (!payload.success) {
+        *retryReason = payload.retryReason;
+    }
+    return payload.root;
+}
+
+void JNTPipelineRecycle(PipelinePointer pipeline, ContextPointer context) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    pipeline->freeContexts.push_back(context);
+    pipeline->changed.notify_all();
+}
+
+// Wakes anything blocked in the pipeline. Payloads that haven't been parsed yet are dropped, and the worker stops after
+// the one it's parsing (if any). Parsed ones can still be taken with JNTPipelineNext
+void JNTPipelineCancel(PipelinePointer pipeline) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    pipeline->cancelled = true;
+    pipeline->changed.notify_all();
+}
+
+// Cancels the pipeline and waits for the worker to stop
+void JNTPipelineRelease(PipelinePointer pipeline) {
+    JNTPipelineCancel(pipeline);
+    pipeline->worker.join();
+    delete pipeline;
+}
+
+// Validation
+//
+// For accepting or rejecting a body without decoding it. Stage 1 (which also validates UTF-8) runs as usual, and then a
+// pass over the structural indexes checks the grammar, the nesting depth, and the syntax of numbers and literals, and a
+// memchr pass checks string escapes, without building a tape or materializing anything. Numbers that are well-formed but
+// too large for a double or 64-bit integer are accepted
+
+static thread_local std::unique_ptr<internal::dom_parser_implementation> sValidationParser;
+static thread_local const implementation *sValidationImplementation = NULL;
+
+// Returns the length of the UTF-8 sequence at s, or 0 if it's invalid
+static size_t JNTUTF8SequenceLength(const uint8_t *s, size_t remaining) {
+    uint8_t c = s[0];
+    size_t size;
+    if (c >= 0xC2 && c <= 0xDF) {
+        size = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        size = 3;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        size = 4;
+    } else {
+        return 0;
+    }
+    if (size > remaining) {
+        return 0;
+    }
+    for (size_t i = 1; i < size; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    // Overlong encodings, surrogates, and code points above U+10FFFF
+    if ((c == 0xE0 && s[1] < 0xA0) || (c == 0xED && s[1] > 0x9F) || (c == 0xF0 && s[1] < 0x90) || (c == 0xF4 && s[1] > 0x8F)) {
+        return 0;
+    }
+    return size;
+}
+
+// Stage 1 only reports what went wrong, so this finds where: the first invalid UTF-8 sequence, the first control
+// character in a string, or the start of an unclosed string
+static size_t JNTLocateStage1Error(const uint8_t *buf, size_t length) {
+    bool inString = false;
+    size_t stringStart = 0;
+    size_t i = 0;
+    while (i < length) {
+        uint8_t c = buf[i];
+        if (c >= 0x80) {
+            size_t size = JNTUTF8SequenceLength(buf + i, length - i);
+            if (size == 0) {
+                return i;
+            }
+            i += size;
+            continue;
+        }
+        if (inString) {
+            if (c == '"') {
+                inString = false;
+            } else if (c < 0x20) {
+                return i;
+            } else if (c == '\\' && i + 1 < length && buf[i + 1] < 0x80) {
+                i++;
+            }
+        } else if (c == '"') {
+            inString = true;
+            stringStart = i;
+        }
+        i++;
+    }
+    return inString ? stringStart : length;
+}
+
+static inline bool JNTIsDigit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+// Stage 1 folds a quote right after a scalar into the scalar, so it doesn't count as an end
+static inline bool JNTIsScalarEnd(const uint8_t *buf, size_t length, size_t index) {
+    if (index == length) {
+        return true;
+    }
+    switch (buf[index]) {
+        case ',': case ':': case ']': case '}': case '[': case '{':
+        case ' ': case '\n': case '\r': case '\t':
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline uint32_t JNTHexValue(const uint8_t *s) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; i++) {
+        uint8_t c = s[i];
+        uint32_t digit;
+        if (JNTIsDigit(c)) {
+            digit = c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            digit = (c | 0x20) - 'a' + 10;
+        } else {
+            return UINT32_MAX;
+        }
+        value = value << 4 | digit;
+    }
+    return value;
+}
+
+// Checks the escapes that start in [position, end). Only strings can hold a backslash once the structure has been
+// checked, so this makes one pass over the whole body rather than one per string. Returns the offset of the first bad
+// escape, or SIZE_MAX
+static size_t JNTValidateEscapes(const uint8_t *buf, size_t length, size_t position, size_t end) {
+    while (position < end) {
+        const uint8_t *escape = (const uint8_t *)memchr(buf + position, '\\', end - position);
+        if (!escape) {
+            break;
+        }
+        size_t offset = escape - buf;
+        switch (offset + 1 < length ? buf[offset + 1] : 0) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                position = offset + 2;
+                break;
+            case 'u': {
+                // Mirrors handle_unicode_codepoint, so that this accepts exactly what the parser does
+                uint32_t codePoint = offset + 6 <= length ? JNTHexValue(buf + offset + 2) : UINT32_MAX;
+                position = offset + 6;
+                if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+                    uint32_t low = position + 6 <= length && buf[position] == '\\' && buf[position + 1] == 'u' ? JNTHexValue(buf + position + 2) : UINT32_MAX;
+                    if (low == UINT32_MAX) {
+                        return offset;
+                    }
+                    codePoint = (((codePoint - 0xD800) << 10) | (low - 0xDC00)) + 0x10000;
+                    position += 6;
+                } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+                    return offset;
+                }
+                if (codePoint > 0x10FFFF) {
+                    return offset;
+                }
+                break;
+            }
+            default:
+                return offset;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Returns the offset just past the number at index, or SIZE_MAX if it isn't one
+static size_t JNTValidateNumber(const uint8_t *buf, size_t length, size_t index) {
+    size_t p = index;
+    if (buf[p] == '-') {
+        p++;
+    }
+    if (p == length || !JNTIsDigit(buf[p])) {
+        return SIZE_MAX;
+    }
+    if (buf[p] == '0') {
+        p++;
+    } else {
+        while (p < length && JNTIsDigit(buf[p])) {
+            p++;
+        }
+    }
+    if (p < length && buf[p] == '.') {
+        p++;
+        if (p == length || !JNTIsDigit(buf[p])) {
+            return SIZE_MAX;
+        }
+        while (p < length && JNTIsDigit(buf[p])) {
+            p++;
+        }
+    }
+    if (p < length && (buf[p] | 0x20) == 'e') {
+        p++;
+        if (p < length && (buf[p] == '+' || buf[p] == '-')) {
+            p++;
+        }
+        if (p == length || !JNTIsDigit(buf[p])) {
+            return SIZE_MAX;
+        }
+        while (p < length && JNTIsDigit(buf[p])) {
+            p++;
+        }
+    }
+    return p;
+}
+
+typedef CF_ENUM(uint8_t, JNTValidationState) {
+    JNTValidationStateValue,
+    JNTValidationStateValueOrArrayEnd,
+    JNTValidationStateKey,
+    JNTValidationStateKeyOrObjectEnd,
+    JNTValidationStateColon,
+    JNTValidationStateCommaOrEnd,
+    JNTValidationStateDone,
+};
+
+static inline bool JNTValidateLiteral(const uint8_t *buf, size_t length, size_t index, const char *literal, size_t literalLength) {
+    return index + literalLength <= length && memcmp(buf + index, literal, literalLength) == 0 && JNTIsScalarEnd(buf, length, index + literalLength);
+}
+
+// Checks everything but string escapes. Returns the offset where it went wrong, or SIZE_MAX
+static size_t JNTValidateStructure(const uint8_t *buf, size_t length, const uint32_t *structurals, uint32_t count) {
+    std::vector<uint8_t> stack;
+    JNTValidationState state = JNTValidationStateValue;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t index = structurals[i];
+        uint8_t c = buf[index];
+        bool isValue = false;
+        switch (state) {
+            case JNTValidationStateKeyOrObjectEnd:
+                if (c == '}') {
+                    stack.pop_back();
+                    isValue = true;
+                    break;
+                }
+                // Otherwise it has to be a key
+            case JNTValidationStateKey:
+                if (c != '"') {
+                    return index;
+                }
+                state = JNTValidationStateColon;
+                break;
+            case JNTValidationStateColon:
+                if (c != ':') {
+                    return index;
+                }
+                state = JNTValidationStateValue;
+                break;
+            case JNTValidationStateValueOrArrayEnd:
+                if (c == ']') {
+                    stack.pop_back();
+                    isValue = true;
+                    break;
+                }
+                // Otherwise it has to be a value
+            case JNTValidationStateValue:
+                switch (c) {
+                    case '{':
+                    case '[':
+                        // As with the parsers, empty containers don't count towards the depth
+                        if (stack.size() + 1 >= DEFAULT_MAX_DEPTH && (i + 1 == count || buf[structurals[i + 1]] != c + 2)) {
+                            return index;
+                        }
+                        stack.push_back(c);
+                        state = c == '{' ? JNTValidationStateKeyOrObjectEnd : JNTValidationStateValueOrArrayEnd;
+                        break;
+                    case '"':
+                        isValue = true;
+                        break;
+                    case 't':
+                        if (!JNTValidateLiteral(buf, length, index, "true", 4)) {
+                            return index;
+                        }
+                        isValue = true;
+                        break;
+                    case 'f':
+                        if (!JNTValidateLiteral(buf, length, index, "false", 5)) {
+                            return index;
+                        }
+                        isValue = true;
+                        break;
+                    case 'n':
+                        if (!JNTValidateLiteral(buf, length, index, "null", 4)) {
+                            return index;
+                        }
+                        isValue = true;
+                        break;
+                    default: {
+                        size_t end = JNTValidateNumber(buf, length, index);
+                        if (end == SIZE_MAX || !JNTIsScalarEnd(buf, length, end)) {
+                            return end == SIZE_MAX ? index : end;
+                        }
+                        isValue = true;
+                        break;
+                    }
+                }
+                break;
+            case JNTValidationStateCommaOrEnd:
+                if (c == ',') {
+                    state = stack.back() == '{' ? JNTValidationStateKey : JNTValidationStateValue;
+                } else if (c == (stack.back() == '{' ? '}' : ']')) {
+                    stack.pop_back();
+                    isValue = true;
+                } else {
+                    return index;
+                }
+                break;
+            case JNTValidationStateDone:
+                // Something after the root value
+                return index;
+        }
+        if (isValue) {
+            state = stack.empty() ? JNTValidationStateDone : JNTValidationStateCommaOrEnd;
+        }
+    }
+    return state == JNTValidationStateDone ? SIZE_MAX : length;
+}
+
+// Returns whether the data is well-formed JSON, with valid UTF-8 and nesting within DEFAULT_MAX_DEPTH. If not,
+// errorOffset is set to the offset of the byte where it went wrong (or the length, if the JSON ended early)
+bool JNTValidateJSON(const void *data, NSInteger length, NSInteger *errorOffset) {
+    const uint8_t *buf = (const uint8_t *)data;
+    if ((uint64_t)length > kDataLimit) {
+        *errorOffset = kDataLimit;
+        return false;
+    }
+    // The SIMD kernels copy the last partial block before reading it, but the fallback one can read a few bytes past
+    // the end
+    const implementation *implementation = JNTActiveImplementation();
+    padded_string padded;
+    if (implementation->name() == "fallback") {
+        padded = padded_string((const char *)data, length);
+        buf = (const uint8_t *)padded.data();
+    }
+    if (!sValidationParser || sValidationImplementation != implementation || sValidationParser->capacity() < (size_t)length) {
+        sValidationParser.reset();
+        sValidationImplementation = implementation;
+        if (implementation->create_dom_parser_implementation(std::max<size_t>(length, 1), DEFAULT_MAX_DEPTH, sValidationParser)) {
+            sValidationParser.reset();
+            *errorOffset = 0;
+            return false;
+        }
+    }
+    error_code error = sValidationParser->stage1(buf, length, stage1_mode::regular);
+    if (error) {
+        *errorOffset = JNTLocateStage1Error(buf, length);
+        return false;
+    }
+    // Escapes are checked up to the first structural error, so that the offset is always that of the first error
+    size_t structureOffset = JNTValidateStructure(buf, length, sValidationParser->structural_indexes.get(), sValidationParser->n_structural_indexes);
+    size_t escapeOffset = JNTValidateEscapes(buf, length, 0, std::min(structureOffset, (size_t)length));
+    if (structureOffset != SIZE_MAX || escapeOffset != SIZE_MAX) {
+        *errorOffset = std::min(structureOffset, escapeOffset);
+        return false;
+    }
+    return true;
+}
+
+// For consumers that stop early. The worker thread, if any, is stopped and joined before this returns
+void JNTDocumentStreamClose(ContextPointer context) {
+    context->document->documentStream.reset();
+}
+
+void JNTReleaseContext(JNTContext *context) {
+    JNTFinishDecodeStats(context);
+    delete context;
+}
+
+template <typename Element>
+static double JNTNumericValue(Element &element) {
+    if (element.template is<double>()) {
+        return element.template get<double>().value();
+    } else if (element.template is<int64_t>()) {
+        return element.template get<int64_t>().value();
+    } else if (element.template is<uint64_t>()) {
+        return element.template get<uint64_t>().value();
+    }
+    return 0;
+}
+
+template <typename Element>
+inline double JNTDocumentDecodeDouble(JNTDecoder decoder, Element element) {
+    if (element.template is<double>()) {
+        return element.template get<double>().value_unsafe();
+    } else {
+        if (element.template is<std::string_view>() && decoder.context->stringsForFloats) {
+            std::string_view string = element.template get<std::string_view>().value_unsafe();
+            if (string == decoder.context->posInfString) {
+                return INFINITY;
+            } else if (string == decoder.context->negInfString) {
+                return -INFINITY;
+            } else if (string == decoder.context->nanString) {
+                return NAN;
+            }
+        }
+        JNTHandleWrongType(decoder, element.type(), "double/float");
+        return 0;
+    }
+}
+
+// Element is either a dom::element or a JNTLazyValue
+template <typename T, typename U, typename Element>
+inline T JNTDocumentDecode(JNTDecoder decoder, Element element) {
+    if constexpr (std::is_same<U, double>()) {
+        return (T)JNTDocumentDecodeDouble(decoder, element);
+    }
+    simdjson_result<U> value = element.template get<U>();
+    if (JNT_UNLIKELY(value.error())) {
+        BOOL elementIsNumeric = element.template is<double>() || element.template is<int64_t>() || element.template is<uint64_t>();
+        if (std::is_integral<T>() && std::is_integral<U>() && elementIsNumeric) {
+            // If we asked for a number type, and simdjson complained strictly because it had a number of a type that
+            // couldn't be losslessly casted to the one we asked for, then the error is that the number doesn't fit
             JNTHandleNumberDoesNotFit(decoder, JNTNumericValue(element), typeid(T).name());
             return (T)0;
         }
@@ -335,33 +2360,64 @@ inline T JNTDocumentDecode(JNTDecoder decoder, dom::element element) {
     return returnValue;
 }
 
-template <>
-inline double JNTDocumentDecode<double, double>(JNTDecoder decoder, dom::element element) {
-    if (element.is<double>()) {
-        return element;
-    } else {
-        if (element.is<std::string_view>() && decoder.context->stringsForFloats) {
-            std::string_view string = element;
-            if (string == decoder.context->posInfString) {
-                return INFINITY;
-            } else if (string == decoder.context->negInfString) {
-                return -INFINITY;
-            } else if (string == decoder.context->nanString) {
-                return NAN;
-            }
+template <typename T, typename U>
+static inline T JNTDocumentDecodeValue(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTDocumentDecode<T, U>(decoder, JNTLazyValue(document, JNTLazyIndex(decoder.element)));
+    }
+    return JNTDocumentDecode<T, U>(decoder, decoder.element);
+}
+
+// Pre-condition: element is an array type
+static inline JNTChunkedDocument *JNTChunkedDocumentFrom(const JNTDecoder &decoder) {
+    JNTChunkedDocument *chunkedDocument = decoder.context ? decoder.context->document->chunkedDocument.get() : NULL;
+    if (!chunkedDocument) {
+        return NULL;
+    }
+    const auto tape = (const internal::tape_ref *)&decoder.element;
+    return tape->doc == &chunkedDocument->rootParser.doc ? chunkedDocument : NULL;
+}
+
+static inline JNTArrayChunk *JNTArrayChunkFrom(JNTChunkedDocument *chunkedDocument, const dom::document *doc, size_t *chunkIndex) {
+    for (size_t i = 0; i < chunkedDocument->chunks.size(); i++) {
+        if (&chunkedDocument->chunks[i]->parser.doc == doc) {
+            *chunkIndex = i;
+            return chunkedDocument->chunks[i].get();
         }
-        JNTHandleWrongType(decoder, element.type(), "double/float");
-        return 0;
     }
+    return NULL;
 }
 
-template <>
-inline float JNTDocumentDecode<float, double>(JNTDecoder decoder, dom::element element) {
-    return (float)JNTDocumentDecode<double, double>(decoder, element);
+static inline bool JNTArrayIteratorIsAtEnd(const JNTArrayIterator &iterator) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(iterator)) {
+        return !JNTLazyIsElement(document, JNTLazyIndex(iterator));
+    }
+    const auto tape = (const simdjson::internal::tape_ref *)&iterator;
+    return tape->tape_ref_type() == internal::tape_type::END_ARRAY;
+}
+
+// Moves an iterator that has reached the end of a chunk on to the start of the next one
+static inline void JNTArrayIteratorCrossChunk(JNTArrayIterator *iterator, JNTDecoder root) {
+    if (JNT_UNLIKELY(root.context->document->chunkedDocument != nullptr)) {
+        JNTChunkedDocument *chunkedDocument = JNTChunkedDocumentFrom(root);
+        if (!chunkedDocument || !JNTArrayIteratorIsAtEnd(*iterator)) {
+            return;
+        }
+        const auto tape = (const internal::tape_ref *)iterator;
+        size_t chunkIndex = 0;
+        if (JNTArrayChunkFrom(chunkedDocument, tape->doc, &chunkIndex) && chunkIndex + 1 < chunkedDocument->chunks.size()) {
+            *iterator = chunkedDocument->chunks[chunkIndex + 1]->array.begin();
+        }
+    }
 }
 
-// Pre-condition: element is an array type
 NSInteger JNTDocumentGetArrayCount(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyGetArrayCount(document, decoder);
+    }
+    if (JNTChunkedDocument *chunkedDocument = JNTChunkedDocumentFrom(decoder)) {
+        return chunkedDocument->count;
+    }
     NSInteger count = 0;
     dom::array array = decoder.element;
     for (auto it = array.begin(); it != array.end(); ++it) {
@@ -371,18 +2427,27 @@ NSInteger JNTDocumentGetArrayCount(JNTDecoder decoder) {
 }
 
 void JNTAdvanceIterator(JNTArrayIterator *iterator, JNTDecoder root) {
-    dom::array array = root.element;
-    assert(*iterator != array.end());
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(*iterator)) {
+        *iterator = JNTLazyMake<JNTArrayIterator>(document, JNTLazyNextElement(document, JNTLazyIndex(*iterator)));
+        return;
+    }
+    assert(!JNTArrayIteratorIsAtEnd(*iterator));
     ++(*iterator);
+    JNTArrayIteratorCrossChunk(iterator, root);
 }
 
 JNTDecoder JNTDecoderFromIterator(JNTArrayIterator *iterator, JNTDecoder root) {
-    dom::array array = root.element;
-    assert(*iterator != array.end());
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(*iterator)) {
+        return JNTCreateDecoder(JNTLazyMake<dom::element>(document, JNTLazyIndex(*iterator)), root.context, root.depth + 1);
+    }
+    assert(!JNTArrayIteratorIsAtEnd(*iterator));
     return JNTCreateDecoder(**iterator, root.context, root.depth + 1);
 }
 
 bool JNTDocumentDecodeNil(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyValue(document, JNTLazyIndex(decoder.element)).is_null();
+    }
     return decoder.element.is_null();
 }
 
@@ -396,53 +2461,178 @@ static bool JNTIteratorsEqual(dom::element &e1, dom::element &e2) {
 }
 
 JNTDictionaryIterator JNTDocumentGetDictionaryIterator(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyMake<JNTDictionaryIterator>(document, JNTLazyIndex(decoder.element) + 1);
+    }
     dom::object object = decoder.element;
     return object.begin();
 }
 
 JNTArrayIterator JNTDocumentGetIterator(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyMake<JNTArrayIterator>(document, JNTLazyIndex(decoder.element) + 1);
+    }
+    if (JNTChunkedDocument *chunkedDocument = JNTChunkedDocumentFrom(decoder)) {
+        if (!chunkedDocument->chunks.empty()) {
+            return chunkedDocument->chunks[0]->array.begin();
+        }
+    }
     dom::array array = decoder.element;
     return array.begin();
 }
 
+// Like JNTLazyCodingPath, walks the tape in order rather than recursing, keeping track of the containers that are open.
+// Returns nil if the target isn't inside element
 NSMutableArray <id> *JNTDocumentCodingPathHelper(dom::element &element, dom::element &targetElement) {
-    if (element.is<dom::array>()) {
-        dom::array array = element;
-        NSInteger i = 0;
-        for (auto member : array) {
-            if (JNTIteratorsEqual(member, targetElement)) {
-                return [@[@(i)] mutableCopy];
-            } else if (member.is<dom::array>() || member.is<dom::object>()) {
-                NSMutableArray *codingPath = JNTDocumentCodingPathHelper(member, targetElement);
-                if (codingPath) {
-                    [codingPath insertObject:@(i) atIndex:0];
-                    return codingPath;
-                }
+    struct Frame {
+        bool isArray;
+        bool expectsKey;
+        size_t keyIndex;
+        NSInteger elementIndex;
+    };
+    const auto tape = (const internal::tape_ref *)&element;
+    size_t target = ((const internal::tape_ref *)&targetElement)->json_index;
+    const uint64_t *words = tape->doc->tape.get();
+    size_t index = tape->json_index;
+    size_t end = std::min(tape->after_element(), target + 1);
+    std::vector<Frame> frames;
+    while (index < end) {
+        auto type = (internal::tape_type)(words[index] >> 56);
+        if (type == internal::tape_type::END_OBJECT || type == internal::tape_type::END_ARRAY) {
+            frames.pop_back();
+            index++;
+            continue;
+        }
+        if (!frames.empty()) {
+            Frame &frame = frames.back();
+            if (frame.isArray) {
+                frame.elementIndex++;
+            } else if (frame.expectsKey) {
+                frame.keyIndex = index;
+                frame.expectsKey = false;
+                index++;
+                continue;
+            } else {
+                frame.expectsKey = true;
             }
-            i++;
         }
-    } else if (element.is<dom::object>()) {
-        dom::object object = element;
-        for (auto [key, value] : object) {
-            if (JNTIteratorsEqual(value, targetElement)) {
-                return [@[@(std::string(key).c_str())] mutableCopy];
+        if (index == target) {
+            if (frames.empty()) {
+                return nil;
             }
-            if (JNTIteratorsEqual(value, targetElement)) {
-                return [@[@(std::string(key).c_str())] mutableCopy];
-            } else if (value.is<dom::array>() || value.is<dom::object>()) {
-                NSMutableArray *codingPath = JNTDocumentCodingPathHelper(value, targetElement);
-                if (codingPath) {
-                    [codingPath insertObject:@(std::string(key).c_str()) atIndex:0];
-                    return codingPath;
+            NSMutableArray <id> *codingPath = [NSMutableArray arrayWithCapacity:frames.size()];
+            for (const Frame &frame : frames) {
+                if (frame.isArray) {
+                    [codingPath addObject:@(frame.elementIndex)];
+                } else {
+                    [codingPath addObject:@(JNTTapeString(element, frame.keyIndex))];
                 }
             }
+            return codingPath;
+        }
+        switch (type) {
+            case internal::tape_type::START_OBJECT:
+                frames.push_back({false, true, 0, 0});
+                index++;
+                break;
+            case internal::tape_type::START_ARRAY:
+                frames.push_back({true, false, 0, -1});
+                index++;
+                break;
+            case internal::tape_type::INT64:
+            case internal::tape_type::UINT64:
+            case internal::tape_type::DOUBLE:
+                index += 2;
+                break;
+            default:
+                index++;
+                break;
         }
     }
     return nil;
 }
 
+// Walks the tokens in order rather than recursing, keeping track of the containers that are open
+static NSArray <id> *JNTLazyCodingPath(JNTLazyDocument *document, uint32_t target) {
+    struct Frame {
+        bool isArray;
+        uint32_t keyIndex;
+        NSInteger elementIndex;
+    };
+    std::vector<Frame> frames;
+    uint32_t index = 0;
+    while (index < document->structuralCount) {
+        if (index == target) {
+            NSMutableArray <id> *codingPath = [NSMutableArray arrayWithCapacity:frames.size()];
+            for (const Frame &frame : frames) {
+                if (frame.isArray) {
+                    [codingPath addObject:@(frame.elementIndex)];
+                } else {
+                    const char *key = JNTLazyString(document, frame.keyIndex);
+                    [codingPath addObject:@(key ?: "")];
+                }
+            }
+            return [codingPath copy];
+        }
+        uint8_t c = JNTLazyChar(document, index);
+        uint8_t next = JNTLazyChar(document, index + 1);
+        if (c == '{' && next != '}') {
+            frames.push_back({false, index + 1, 0});
+            index += 3;
+            continue;
+        } else if (c == '[' && next != ']') {
+            frames.push_back({true, 0, 0});
+            index++;
+            continue;
+        }
+        index += (c == '{' || c == '[') ? 2 : 1;
+        // Close any containers that end here, then move on to the next value
+        while (!frames.empty()) {
+            c = JNTLazyChar(document, index);
+            if (c == ',') {
+                Frame &frame = frames.back();
+                if (frame.isArray) {
+                    frame.elementIndex++;
+                    index++;
+                } else {
+                    frame.keyIndex = index + 1;
+                    index += 3;
+                }
+                break;
+            } else if (c == '}' || c == ']') {
+                frames.pop_back();
+                index++;
+            } else {
+                return @[];
+            }
+        }
+        if (frames.empty()) {
+            break;
+        }
+    }
+    return @[];
+}
+
 NSArray <id> *JNTDocumentCodingPath(JNTDecoder targetDecoder) {
-    dom::element &element = targetDecoder.context->root;
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(targetDecoder.element)) {
+        return JNTLazyCodingPath(document, JNTLazyIndex(targetDecoder.element));
+    }
+    if (JNTChunkedDocument *chunkedDocument = targetDecoder.context->document->chunkedDocument.get()) {
+        // Find the path within the chunk, then make the first index relative to the array as a whole
+        const auto tape = (const internal::tape_ref *)&targetDecoder.element;
+        size_t chunkIndex = 0;
+        JNTArrayChunk *chunk = JNTArrayChunkFrom(chunkedDocument, tape->doc, &chunkIndex);
+        if (!chunk) {
+            return @[];
+        }
+        NSMutableArray *array = JNTDocumentCodingPathHelper(chunk->root, targetDecoder.element);
+        if (!array) {
+            return @[];
+        }
+        array[0] = @([array[0] integerValue] + chunk->firstElement);
+        return [array copy];
+    }
+    dom::element &element = targetDecoder.context->document->root;
     if (JNTIteratorsEqual(element, targetDecoder.element)) {
         return @[];
     }
@@ -452,6 +2642,16 @@ NSArray <id> *JNTDocumentCodingPath(JNTDecoder targetDecoder) {
 
 NSArray <NSString *> *JNTDocumentAllKeys(JNTDecoder decoder) {
     NSMutableArray <NSString *>*keys = [NSMutableArray array];
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element) + 1;
+        for (; JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+            const char *cString = JNTLazyString(document, index);
+            if (cString) {
+                [keys addObject:@(cString)];
+            }
+        }
+        return [keys copy];
+    }
     dom::object object = decoder.element;
     for (auto [key, value] : object) {
         const char *cString = key.data();
@@ -461,22 +2661,113 @@ NSArray <NSString *> *JNTDocumentAllKeys(JNTDecoder decoder) {
 }
 
 void JNTDocumentForAllKeyValuePairs(JNTDecoder decoderOriginal, void (^callback)(const char *key, JNTDecoder element)) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoderOriginal.element)) {
+        uint32_t index = JNTLazyIndex(decoderOriginal.element);
+        if (JNTLazyChar(document, index) != '{') {
+            JNTHandleWrongType(decoderOriginal, JNTLazyValue(document, index).type(), "dictionary");
+            return;
+        }
+        for (index++; JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+            const char *key = JNTLazyString(document, index);
+            if (!key) {
+                JNTHandleMalformedJSON(decoderOriginal);
+                return;
+            }
+            decoderOriginal.context->stats.fieldsRead++;
+            callback(key, JNTCreateDecoder(JNTLazyMake<dom::element>(document, index + 2), decoderOriginal.context, decoderOriginal.depth + 1));
+        }
+        return;
+    }
     const auto &object = decoderOriginal.element.get<dom::object>();
     if (object.error()) {
         JNTHandleWrongType(decoderOriginal, decoderOriginal.element.type(), "dictionary");
         return;
     }
     for (auto [key, value] : object) {
+        decoderOriginal.context->stats.fieldsRead++;
         JNTDecoder decoder = JNTCreateDecoder(value, decoderOriginal.context, decoderOriginal.depth + 1);
         callback(key.data(), decoder);
     }
 }
 
+// Includes any duplicate keys. Returns 0, with the context's error set, if it isn't an object
+NSInteger JNTDocumentGetDictionaryCount(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element);
+        if (JNTLazyChar(document, index) != '{') {
+            JNTHandleWrongType(decoder, JNTLazyValue(document, index).type(), "dictionary");
+            return 0;
+        }
+        NSInteger count = 0;
+        for (index++; JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+            count++;
+        }
+        return count;
+    }
+    const auto &object = decoder.element.get<dom::object>();
+    if (object.error()) {
+        JNTHandleWrongType(decoder, decoder.element.type(), "dictionary");
+        return 0;
+    }
+    NSInteger count = object.value_unsafe().size();
+    // The count on the tape saturates at 24 bits
+    if (count == 0xFFFFFF) {
+        count = 0;
+        for (auto it = object.value_unsafe().begin(); it != object.value_unsafe().end(); ++it) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// For decoding a whole dictionary, fills in the keys and values of the first count pairs (e.g. all of them, with
+// JNTDocumentGetDictionaryCount) in one pass, in document order. Any duplicate keys are kept, for the host to resolve.
+// Returns false, with the context's error set, if it isn't an object
+bool JNTDocumentGetKeysAndValues(JNTDecoder decoder, JNTStringSpan *keys, JNTDecoder *values, NSInteger count) {
+    NSInteger i = 0;
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element);
+        if (JNTLazyChar(document, index) != '{') {
+            JNTHandleWrongType(decoder, JNTLazyValue(document, index).type(), "dictionary");
+            return false;
+        }
+        for (index++; i < count && JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index), i++) {
+            const char *key = JNTLazyString(document, index);
+            if (!key) {
+                JNTHandleMalformedJSON(decoder);
+                return false;
+            }
+            keys[i] = {key, (NSInteger)strlen(key)};
+            values[i] = JNTCreateDecoder(JNTLazyMake<dom::element>(document, index + 2), decoder.context, decoder.depth + 1);
+        }
+    } else {
+        const auto &object = decoder.element.get<dom::object>();
+        if (object.error()) {
+            JNTHandleWrongType(decoder, decoder.element.type(), "dictionary");
+            return false;
+        }
+        for (auto it = object.value_unsafe().begin(); i < count && it != object.value_unsafe().end(); ++it, i++) {
+            std::string_view key = it.key();
+            keys[i] = {key.data(), (NSInteger)key.size()};
+            values[i] = JNTCreateDecoder(it.value(), decoder.context, decoder.depth + 1);
+        }
+    }
+    decoder.context->stats.fieldsRead += i;
+    return true;
+}
+
 const char *JNTDocumentKeyFromIterator(JNTDictionaryIterator iterator) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(iterator)) {
+        return JNTLazyString(document, JNTLazyIndex(iterator));
+    }
     return iterator.key_c_str();
 }
 
 simdjson_result<dom::element> JNTDocumentFindValue(JNTDecoder decoder, const char *cKey, JNTDictionaryIterator *iteratorPtr) {
+    decoder.context->stats.lookups++;
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyFindValue(document, decoder, cKey, iteratorPtr);
+    }
     auto iterator = *iteratorPtr;
     std::string_view key = cKey;
     const auto searchStart = iterator;
@@ -493,6 +2784,7 @@ simdjson_result<dom::element> JNTDocumentFindValue(JNTDecoder decoder, const cha
         ++iterator;
     }
     if (!found) {
+        decoder.context->stats.rewinds++;
         iterator = object.begin();
         while (iterator != searchStart) {
             if (key == iterator.key()) {
@@ -503,84 +2795,702 @@ simdjson_result<dom::element> JNTDocumentFindValue(JNTDecoder decoder, const cha
             ++iterator;
         }
     }
-    if (!found) {
-        return simdjson_result<dom::element>(NO_SUCH_FIELD);
+    if (!found) {
+        return simdjson_result<dom::element>(NO_SUCH_FIELD);
+    }
+    decoder.context->stats.fieldsRead++;
+    *iteratorPtr = iterator;
+    return simdjson_result<dom::element>(std::move(child));
+}
+
+bool JNTDocumentContains(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) {
+    const auto &result = JNTDocumentFindValue(decoder, key, iteratorPtr);
+    return result.error() == SUCCESS;
+}
+
+JNTDecoder JNTDocumentFetchValue(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) {
+    const auto &result = JNTDocumentFindValue(decoder, key, iteratorPtr);
+    if (result.error() != SUCCESS) {
+        JNTHandleMemberDoesNotExist(decoder, key);
+        return decoder;
+    }
+    return JNTCreateDecoder(result.value_unsafe(), decoder.context, decoder.depth + 1);
+}
+
+bool JNTDocumentValueIsDictionary(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyChar(document, JNTLazyIndex(decoder.element)) == '{';
+    }
+    return decoder.element.is<dom::object>();
+}
+
+bool JNTDocumentValueIsArray(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyChar(document, JNTLazyIndex(decoder.element)) == '[';
+    }
+    return decoder.element.is<dom::array>();
+}
+
+bool JNTDocumentValueIsInteger(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        JNTLazyValue value(document, JNTLazyIndex(decoder.element));
+        return value.is<int64_t>() || value.is<uint64_t>();
+    }
+    return decoder.element.is<int64_t>() || decoder.element.is<uint64_t>();
+}
+
+bool JNTDocumentValueIsDouble(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        return JNTLazyValue(document, JNTLazyIndex(decoder.element)).is<double>();
+    }
+    return decoder.element.is<double>();
+}
+
+bool JNTDocumentValueIsNumber(JNTDecoder decoder) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        char c = JNTLazyChar(document, JNTLazyIndex(decoder.element));
+        return c == '-' || (c >= '0' && c <= '9');
+    }
+    return decoder.element.is_number();
+}
+
+bool JNTIsNumericCharacter(char c) {
+    return c == 'e' || c == 'E' || c == '-' || c == '.' || isnumber(c);
+}
+
+ContextPointer JNTGetContext(JNTDecoder decoder) {
+    return decoder.context;
+}
+
+size_t JNTGetDepth(JNTDecoder decoder) {
+    return decoder.depth;
+}
+
+const char *JNTDocumentDecode__DecimalString(JNTDecoder decoder, int32_t *outLength) {
+    *outLength = 0; // Making sure it doesn't get left uninitialized
+    // Documents over 4GB are split into chunks, each with its own copy of the JSON, so offsets stay within 32 bits
+    uint64_t offset = 0;
+    const char *dataStart = decoder.context->document->originalString;
+    const char *dataEnd = dataStart + decoder.context->document->originalStringLength;
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element);
+        if (!JNTLazyIsNumberStart(JNTLazyChar(document, index))) {
+            return NULL;
+        }
+        offset = document->structurals[index];
+    } else {
+        offset = decoder.element.get_location_of_number_in_json();
+        if (JNTChunkedDocument *chunkedDocument = decoder.context->document->chunkedDocument.get()) {
+            const auto tape = (const internal::tape_ref *)&decoder.element;
+            size_t chunkIndex = 0;
+            JNTArrayChunk *chunk = JNTArrayChunkFrom(chunkedDocument, tape->doc, &chunkIndex);
+            if (!chunk) {
+                return NULL;
+            }
+            dataStart = chunk->json.data();
+            dataEnd = dataStart + chunk->json.size();
+        }
+    }
+    const char *string = dataStart + offset;
+    if (string >= dataEnd) {
+        return NULL;
+    }
+    int32_t length = 0;
+    // simdjson has already done validation on the numbers, so just try to find the end of the number.
+    // we could also use the structural character idxs, probably
+    while (JNTIsNumericCharacter(string[length]) && string + length < dataEnd) {
+        length++;
+    }
+    *outLength = length;
+    return string;
+}
+
+#define DECODE(A, B) DECODE_NAMED(A, B, A)
+
+#define DECODE_NAMED(A, B, C) \
+A JNTDocumentDecode__##C(JNTDecoder decoder) { \
+    return JNTDocumentDecodeValue<A, B>(decoder); \
+}
+
+ENUMERATE(DECODE);
+
+// Looks up the key, checks for null, and decodes, all with a single search of the object
+template <typename T, typename U>
+static inline T JNTDocumentDecodeKeyed(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) {
+    const auto &result = JNTDocumentFindValue(decoder, key, iteratorPtr);
+    if (JNT_UNLIKELY(result.error() != SUCCESS)) {
+        JNTHandleMemberDoesNotExist(decoder, key);
+        return (T)0;
+    }
+    JNTDecoder value = JNTCreateDecoder(result.value_unsafe(), decoder.context, decoder.depth + 1);
+    return JNTDocumentDecodeValue<T, U>(value);
+}
+
+template <typename T, typename U>
+static inline T JNTDocumentDecodeKeyedIfPresent(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr, bool *isPresent, bool *isNull) {
+    const auto &result = JNTDocumentFindValue(decoder, key, iteratorPtr);
+    *isPresent = result.error() == SUCCESS;
+    *isNull = false;
+    if (!*isPresent) {
+        return (T)0;
+    }
+    JNTDecoder value = JNTCreateDecoder(result.value_unsafe(), decoder.context, decoder.depth + 1);
+    if (JNTDocumentDecodeNil(value)) {
+        *isNull = true;
+        return (T)0;
+    }
+    return JNTDocumentDecodeValue<T, U>(value);
+}
+
+#define DECODE_KEYED(A, B) DECODE_KEYED_NAMED(A, B, A)
+
+#define DECODE_KEYED_NAMED(A, B, C) \
+A JNTDocumentDecodeKeyed__##C(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) { \
+    return JNTDocumentDecodeKeyed<A, B>(decoder, key, iteratorPtr); \
+} \
+A JNTDocumentDecodeKeyedIfPresent__##C(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr, bool *isPresent, bool *isNull) { \
+    return JNTDocumentDecodeKeyedIfPresent<A, B>(decoder, key, iteratorPtr, isPresent, isNull); \
+}
+
+ENUMERATE(DECODE_KEYED);
+
+// Decodes the current element and advances, reading the end of the array straight off the tape rather than
+// re-creating the array from the root to compare against array.end()
+template <typename T, typename U>
+static inline T JNTIteratorDecode(JNTArrayIterator *iterator, JNTDecoder root, bool *isAtEnd) {
+    assert(!JNTArrayIteratorIsAtEnd(*iterator));
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(*iterator)) {
+        uint32_t index = JNTLazyIndex(*iterator);
+        JNTDecoder value = JNTCreateDecoder(JNTLazyMake<dom::element>(document, index), root.context, root.depth + 1);
+        T result = JNTDocumentDecodeValue<T, U>(value);
+        *iterator = JNTLazyMake<JNTArrayIterator>(document, JNTLazyNextElement(document, index));
+        *isAtEnd = JNTArrayIteratorIsAtEnd(*iterator);
+        return result;
+    }
+    JNTDecoder value = JNTCreateDecoder(**iterator, root.context, root.depth + 1);
+    T result = JNTDocumentDecode<T, U>(value, value.element);
+    ++(*iterator);
+    JNTArrayIteratorCrossChunk(iterator, root);
+    *isAtEnd = JNTArrayIteratorIsAtEnd(*iterator);
+    return result;
+}
+
+#define DECODE_ITER(A, B) DECODE_ITER_NAMED(A, B, A)
+
+#define DECODE_ITER_NAMED(A, B, C) \
+A JNTIteratorDecode__##C(JNTArrayIterator *iterator, JNTDecoder root, bool *isAtEnd) { \
+    return JNTIteratorDecode<A, B>(iterator, root, isAtEnd); \
+}
+
+ENUMERATE(DECODE_ITER);
+
+// Key tables
+//
+// A perfect hash over a fixed set of keys, e.g. a model's, which is found up front so that looking up a key from a
+// document costs a hash and a single comparison. Used by key sets and decode plans, which never change once created,
+// so they can be shared across threads
+
+static const NSInteger kJNTKeyTableMaxCount = 64;
+static const uint8_t kJNTKeyTableEmptySlot = UINT8_MAX;
+
+struct JNTKeyTable {
+    std::vector<std::string> keys;
+    // For each hash value, the index of the key that has it
+    std::vector<uint8_t> slots;
+    uint64_t seed = 0;
+    uint64_t slotMask = 0;
+};
+
+static inline uint64_t JNTKeyHash(const char *key, size_t length, uint64_t seed) {
+    uint64_t hash = seed ^ length;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 0x100000001B3ULL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+// Tries seeds with tables of increasing size until every key lands in a slot of its own. Fails if a key is there twice.
+// With up to 64 times as many slots as keys, a few hundred keys still find a seed quickly
+static bool JNTKeyTableBuild(JNTKeyTable *table) {
+    size_t size = 1;
+    while (size < table->keys.size()) {
+        size <<= 1;
+    }
+    for (size_t tableSize = size; tableSize <= size * 64; tableSize <<= 1) {
+        for (uint64_t seed = 1; seed <= 256; seed++) {
+            table->slots.assign(tableSize, kJNTKeyTableEmptySlot);
+            bool collided = false;
+            for (size_t i = 0; i < table->keys.size() && !collided; i++) {
+                const std::string &key = table->keys[i];
+                uint8_t &slot = table->slots[JNTKeyHash(key.data(), key.size(), seed) & (tableSize - 1)];
+                collided = slot != kJNTKeyTableEmptySlot;
+                slot = i;
+            }
+            if (!collided) {
+                table->seed = seed;
+                table->slotMask = tableSize - 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Returns the index of the key, or -1
+static inline NSInteger JNTKeyTableFind(const JNTKeyTable &table, const char *key, size_t length) {
+    uint8_t slot = table.slots[JNTKeyHash(key, length, table.seed) & table.slotMask];
+    if (slot == kJNTKeyTableEmptySlot) {
+        return -1;
+    }
+    const std::string &tableKey = table.keys[slot];
+    return tableKey.size() == length && memcmp(tableKey.data(), key, length) == 0 ? slot : -1;
+}
+
+// Calls visit(key index, value), with a dom::element or a JNTLazyValue, for each of the table's keys that's in the
+// object, in a single pass over it. If an object has the same key twice, the first one is used, as with the keyed
+// decoders. Keys are matched as they are in the document, so for snake case conversion, call JNTConvertSnakeToCamel
+// first. Sets found to the mask of keys that were found. Returns false, with the context's error set, if it isn't an
+// object
+template <typename Visitor>
+static inline bool JNTForEachTableKey(JNTDecoder decoder, const JNTKeyTable &table, uint64_t *foundPtr, Visitor visit) {
+    uint64_t found = 0;
+    *foundPtr = 0;
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element);
+        if (JNTLazyChar(document, index) != '{') {
+            JNTHandleWrongType(decoder, JNTLazyValue(document, index).type(), "dictionary");
+            return false;
+        }
+        for (index++; JNTLazyIsKey(document, index); index = JNTLazyNextKey(document, index)) {
+            const char *key = JNTLazyString(document, index);
+            if (!key) {
+                JNTHandleMalformedJSON(decoder);
+                return false;
+            }
+            NSInteger i = JNTKeyTableFind(table, key, strlen(key));
+            if (i < 0 || (found & (1ULL << i))) {
+                continue;
+            }
+            found |= 1ULL << i;
+            JNTLazyValue value(document, index + 2);
+            visit(i, value);
+        }
+    } else {
+        const auto &object = decoder.element.get<dom::object>();
+        if (object.error()) {
+            JNTHandleWrongType(decoder, decoder.element.type(), "dictionary");
+            return false;
+        }
+        for (auto [key, value] : object) {
+            NSInteger i = JNTKeyTableFind(table, key.data(), key.size());
+            if (i < 0 || (found & (1ULL << i))) {
+                continue;
+            }
+            found |= 1ULL << i;
+            visit(i, value);
+        }
+    }
+    decoder.context->stats.fieldsRead += __builtin_popcountll(found);
+    *foundPtr = found;
+    return true;
+}
+
+// Key sets
+//
+// For models with many required keys, finding all of them with one pass over the object, rather than a search per key
+
+struct JNTKeySet {
+    JNTKeyTable table;
+};
+
+// Returns NULL if there are more than 64 keys, or the same key is there twice
+KeySetPointer JNTKeySetCreate(const char * const *keys, NSInteger count) {
+    if (count < 0 || count > kJNTKeyTableMaxCount) {
+        return NULL;
+    }
+    std::unique_ptr<JNTKeySet> keySet(new JNTKeySet());
+    keySet->table.keys.assign(keys, keys + count);
+    if (!JNTKeyTableBuild(&keySet->table)) {
+        return NULL;
+    }
+    return keySet.release();
+}
+
+void JNTKeySetRelease(KeySetPointer keySet) {
+    delete keySet;
+}
+
+// Returns the mask of keys that are in the object (bit i for the set's key i), and for each of them, sets values[i] to
+// its value, which can then be decoded directly. Entries for missing keys are left as they were
+uint64_t JNTDocumentFindKeys(JNTDecoder decoder, KeySetPointer keySet, JNTDecoder *values) {
+    uint64_t found = 0;
+    JNTForEachTableKey(decoder, keySet->table, &found, [&](NSInteger i, auto &value) {
+        if constexpr (std::is_same<std::decay_t<decltype(value)>, JNTLazyValue>()) {
+            values[i] = JNTCreateDecoder(JNTLazyMake<dom::element>(value.document, value.index), decoder.context, decoder.depth + 1);
+        } else {
+            values[i] = JNTCreateDecoder(value, decoder.context, decoder.depth + 1);
+        }
+    });
+    return found;
+}
+
+// Discriminators
+//
+// Polymorphic payloads name their concrete type with a string under a discriminator key. Rather than decode it into a
+// native string and compare it against each type's name, the raw bytes are looked up in a key set of candidate names
+
+// Element is either a dom::element or a JNTLazyValue
+template <typename Element>
+static inline NSInteger JNTKeyTableMatch(JNTDecoder decoder, Element element, const JNTKeyTable &table) {
+    simdjson_result<std::string_view> result = element.template get<std::string_view>();
+    if (JNT_UNLIKELY(result.error())) {
+        JNTHandleWrongType(decoder, element.type(), "string");
+        return -1;
+    }
+    std::string_view string = result.value_unsafe();
+    return JNTKeyTableFind(table, string.data(), string.size());
+}
+
+// Returns -1 if the value isn't one of the candidates, which isn't an error, so that the host can fall back to a default
+// type. A missing, null, or non-string value is an error, and also returns -1
+NSInteger JNTDocumentPeekDiscriminator(JNTDecoder decoder, const char *key, KeySetPointer candidates) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(decoder.element)) {
+        uint32_t index = JNTLazyIndex(decoder.element);
+        if (JNTLazyChar(document, index) != '{') {
+            JNTHandleWrongType(decoder, JNTLazyValue(document, index).type(), "dictionary");
+            return -1;
+        }
+    } else if (!decoder.element.is<dom::object>()) {
+        JNTHandleWrongType(decoder, decoder.element.type(), "dictionary");
+        return -1;
+    }
+    JNTDictionaryIterator iterator = JNTDocumentGetDictionaryIterator(decoder);
+    simdjson_result<dom::element> result = JNTDocumentFindValue(decoder, key, &iterator);
+    if (result.error()) {
+        JNTHandleMemberDoesNotExist(decoder, key);
+        return -1;
+    }
+    JNTDecoder value = JNTCreateDecoder(result.value_unsafe(), decoder.context, decoder.depth + 1);
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(value.element)) {
+        return JNTKeyTableMatch(value, JNTLazyValue(document, JNTLazyIndex(value.element)), candidates->table);
     }
-    *iteratorPtr = iterator;
-    return simdjson_result<dom::element>(std::move(child));
+    return JNTKeyTableMatch(value, value.element, candidates->table);
 }
 
-bool JNTDocumentContains(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) {
-    const auto &result = JNTDocumentFindValue(decoder, key, iteratorPtr);
-    return result.error() == SUCCESS;
-}
+// Enum tables
+//
+// String-backed enums register their raw values once, and then each case is matched straight from the document's bytes
+// rather than from a native string. Not limited to 64 like key sets, since there's no mask
 
-JNTDecoder JNTDocumentFetchValue(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr) {
-    const auto &result = JNTDocumentFindValue(decoder, key, iteratorPtr);
-    if (result.error() != SUCCESS) {
-        JNTHandleMemberDoesNotExist(decoder, key);
-        return decoder;
+static const NSInteger kJNTEnumTableMaxCount = kJNTKeyTableEmptySlot;
+
+struct JNTEnumTable {
+    JNTKeyTable table;
+};
+
+// Returns NULL if there are more than 255 raw values, or the same one is used twice
+EnumTablePointer JNTEnumTableCreate(const char * const *rawValues, NSInteger count) {
+    if (count < 0 || count > kJNTEnumTableMaxCount) {
+        return NULL;
     }
-    return JNTCreateDecoder(result.value_unsafe(), decoder.context, decoder.depth + 1);
+    std::unique_ptr<JNTEnumTable> enumTable(new JNTEnumTable());
+    enumTable->table.keys.assign(rawValues, rawValues + count);
+    if (!JNTKeyTableBuild(&enumTable->table)) {
+        return NULL;
+    }
+    return enumTable.release();
 }
 
-bool JNTDocumentValueIsDictionary(JNTDecoder decoder) {
-    return decoder.element.is<dom::object>();
+void JNTEnumTableRelease(EnumTablePointer table) {
+    delete table;
 }
 
-bool JNTDocumentValueIsArray(JNTDecoder decoder) {
-    return decoder.element.is<dom::array>();
+// Element is either a dom::element or a JNTLazyValue
+template <typename Element>
+static inline NSInteger JNTEnumTableDecode(JNTDecoder value, Element element, const JNTKeyTable &table) {
+    simdjson_result<std::string_view> result = element.template get<std::string_view>();
+    if (JNT_UNLIKELY(result.error())) {
+        JNTHandleWrongType(value, element.type(), "string");
+        return -1;
+    }
+    std::string_view string = result.value_unsafe();
+    NSInteger index = JNTKeyTableFind(table, string.data(), string.size());
+    if (JNT_UNLIKELY(index < 0)) {
+        JNTHandleInvalidRawValue(value, string);
+    }
+    return index;
 }
 
-bool JNTDocumentValueIsInteger(JNTDecoder decoder) {
-    return decoder.element.is<int64_t>() || decoder.element.is<uint64_t>();
+// Returns the index of the case, or -1 with the context's error set
+NSInteger JNTDocumentDecodeEnum(JNTDecoder value, EnumTablePointer table) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(value.element)) {
+        return JNTEnumTableDecode(value, JNTLazyValue(document, JNTLazyIndex(value.element)), table->table);
+    }
+    return JNTEnumTableDecode(value, value.element, table->table);
 }
 
-bool JNTDocumentValueIsDouble(JNTDecoder decoder) {
-    return decoder.element.is<double>();
+// Writes the index of each element's case to outIndexes, which has room for count of them, e.g. the array's count.
+// Stops at the first element that isn't one of the cases, with the context's error set
+bool JNTDocumentDecodeEnumArray(JNTDecoder array, EnumTablePointer table, NSInteger *outIndexes, NSInteger count) {
+    if (JNTLazyDocument *document = JNTLazyDocumentFrom(array.element)) {
+        uint32_t index = JNTLazyIndex(array.element);
+        if (JNTLazyChar(document, index) != '[') {
+            JNTHandleWrongType(array, JNTLazyValue(document, index).type(), "array");
+            return false;
+        }
+        for (index++; count > 0 && JNTLazyIsElement(document, index); index = JNTLazyNextElement(document, index)) {
+            JNTDecoder value = JNTCreateDecoder(JNTLazyMake<dom::element>(document, index), array.context, array.depth + 1);
+            NSInteger caseIndex = JNTEnumTableDecode(value, JNTLazyValue(document, index), table->table);
+            if (JNT_UNLIKELY(caseIndex < 0)) {
+                return false;
+            }
+            *outIndexes++ = caseIndex;
+            count--;
+        }
+        return true;
+    }
+    if (!array.element.is<dom::array>()) {
+        JNTHandleWrongType(array, array.element.type(), "array");
+        return false;
+    }
+    JNTArrayIterator iterator = JNTDocumentGetIterator(array);
+    for (; count > 0 && !JNTArrayIteratorIsAtEnd(iterator); count--) {
+        JNTDecoder value = JNTCreateDecoder(*iterator, array.context, array.depth + 1);
+        NSInteger caseIndex = JNTEnumTableDecode(value, value.element, table->table);
+        if (JNT_UNLIKELY(caseIndex < 0)) {
+            return false;
+        }
+        *outIndexes++ = caseIndex;
+        ++iterator;
+        JNTArrayIteratorCrossChunk(&iterator, array);
+    }
+    return true;
 }
 
-bool JNTIsNumericCharacter(char c) {
-    return c == 'e' || c == 'E' || c == '-' || c == '.' || isnumber(c);
+// Decode plans
+//
+// For hot models, a plan decodes a whole object into a C struct in one pass, instead of a round trip per field. Each key
+// in the object costs a lookup in the plan's key table and a switch on the field's type. Failures only show up in the
+// result's masks, so that callers can fall back to the keyed decoders to get the usual errors
+
+struct JNTPlan {
+    struct Field {
+        JNTFieldType type;
+        size_t offset;
+    };
+    JNTKeyTable table;
+    std::vector<Field> fields;
+    uint64_t requiredMask = 0;
+};
+
+// Returns NULL if there are more than 64 fields, or the same key is used twice
+PlanPointer JNTPlanCreate(const JNTPlanField *fields, NSInteger count) {
+    if (count < 0 || count > kJNTKeyTableMaxCount) {
+        return NULL;
+    }
+    std::unique_ptr<JNTPlan> plan(new JNTPlan());
+    for (NSInteger i = 0; i < count; i++) {
+        plan->table.keys.push_back(fields[i].key);
+        plan->fields.push_back({fields[i].type, (size_t)fields[i].offset});
+        if (!fields[i].isOptional) {
+            plan->requiredMask |= 1ULL << i;
+        }
+    }
+    if (!JNTKeyTableBuild(&plan->table)) {
+        return NULL;
+    }
+    return plan.release();
 }
 
-ContextPointer JNTGetContext(JNTDecoder decoder) {
-    return decoder.context;
+void JNTPlanRelease(PlanPointer plan) {
+    delete plan;
 }
 
-size_t JNTGetDepth(JNTDecoder decoder) {
-    return decoder.depth;
+// Like JNTDocumentDecode, but reports failure instead of setting the context's error
+template <typename T, typename U, typename Element>
+static inline bool JNTPlanStore(JNTContext *context, Element &element, uint8_t *out) {
+    T result;
+    if constexpr (std::is_same<U, double>()) {
+        double value = 0;
+        if (element.template get<double>().get(value)) {
+            if (!element.template is<std::string_view>() || !context->stringsForFloats) {
+                return false;
+            }
+            std::string_view string = element.template get<std::string_view>().value_unsafe();
+            if (string == context->posInfString) {
+                value = INFINITY;
+            } else if (string == context->negInfString) {
+                value = -INFINITY;
+            } else if (string == context->nanString) {
+                value = NAN;
+            } else {
+                return false;
+            }
+        }
+        result = (T)value;
+    } else {
+        U value;
+        if (element.template get<U>().get(value)) {
+            return false;
+        }
+        result = (T)value;
+        if ((U)result != value) {
+            return false;
+        }
+    }
+    memcpy(out, &result, sizeof(T));
+    return true;
 }
 
-const char *JNTDocumentDecode__DecimalString(JNTDecoder decoder, int32_t *outLength) {
-    *outLength = 0; // Making sure it doesn't get left uninitialized
-    // todo: use uint64_t everywhere here if we ever support > 4GB files
-    uint64_t offset = decoder.element.get_location_of_number_in_json();
-    const char *dataStart = decoder.context->originalString;
-    const char *dataEnd = dataStart + decoder.context->originalStringLength;
-    const char *string = dataStart + offset;
-    if (string >= dataEnd) {
-        return NULL;
+template <typename Element>
+static inline bool JNTPlanStoreField(JNTContext *context, JNTFieldType type, Element &element, uint8_t *out) {
+    switch (type) {
+        case JNTFieldTypeBool:
+            return JNTPlanStore<bool, bool>(context, element, out);
+        case JNTFieldTypeInt8:
+            return JNTPlanStore<int8_t, int64_t>(context, element, out);
+        case JNTFieldTypeUInt8:
+            return JNTPlanStore<uint8_t, int64_t>(context, element, out);
+        case JNTFieldTypeInt16:
+            return JNTPlanStore<int16_t, int64_t>(context, element, out);
+        case JNTFieldTypeUInt16:
+            return JNTPlanStore<uint16_t, int64_t>(context, element, out);
+        case JNTFieldTypeInt32:
+            return JNTPlanStore<int32_t, int64_t>(context, element, out);
+        case JNTFieldTypeUInt32:
+            return JNTPlanStore<uint32_t, int64_t>(context, element, out);
+        case JNTFieldTypeInt64:
+            return JNTPlanStore<int64_t, int64_t>(context, element, out);
+        case JNTFieldTypeUInt64:
+            return JNTPlanStore<uint64_t, uint64_t>(context, element, out);
+        case JNTFieldTypeInt:
+            return JNTPlanStore<NSInteger, int64_t>(context, element, out);
+        case JNTFieldTypeUInt:
+            return JNTPlanStore<NSUInteger, uint64_t>(context, element, out);
+        case JNTFieldTypeFloat:
+            return JNTPlanStore<float, double>(context, element, out);
+        case JNTFieldTypeDouble:
+            return JNTPlanStore<double, double>(context, element, out);
+        case JNTFieldTypeString:
+            return JNTPlanStore<const char *, const char *>(context, element, out);
     }
-    int32_t length = 0;
-    // simdjson has already done validation on the numbers, so just try to find the end of the number.
-    // we could also use the structural character idxs, probably
-    while (JNTIsNumericCharacter(string[length]) && string + length < dataEnd) {
-        length++;
+    return false;
+}
+
+// Fields that aren't decoded are left as they were in the struct. Returns whether every required field was decoded and
+// nothing was mismatched
+bool JNTDecodeWithPlan(JNTDecoder decoder, PlanPointer plan, void *outStruct, JNTPlanResult *result) {
+    uint8_t *out = (uint8_t *)outStruct;
+    *result = {0, 0, 0};
+    uint64_t found = 0;
+    bool isObject = JNTForEachTableKey(decoder, plan->table, &found, [&](NSInteger i, auto &value) {
+        if (value.is_null()) {
+            return;
+        }
+        const JNTPlan::Field &field = plan->fields[i];
+        if (JNTPlanStoreField(decoder.context, field.type, value, out + field.offset)) {
+            result->decoded |= 1ULL << i;
+        } else {
+            result->mismatched |= 1ULL << i;
+        }
+    });
+    if (!isObject) {
+        return false;
     }
-    *outLength = length;
-    return string;
+    result->missing = plan->requiredMask & ~(result->decoded | result->mismatched);
+    return result->missing == 0 && result->mismatched == 0;
 }
 
-#define DECODE(A, B) DECODE_NAMED(A, B, A)
-
-#define DECODE_NAMED(A, B, C) \
-A JNTDocumentDecode__##C(JNTDecoder decoder) { \
-    return JNTDocumentDecode<A, B>(decoder, decoder.element); \
+// Parallel decoding
+//
+// Each worker decodes with a context of its own, which shares the parsed document but has its own error and scratch
+// buffers. Workers take ranges of the array in order from a shared counter, and once any element has failed, ranges
+// past it aren't started. The error from the lowest index is the one that ends up on the array's context, so the
+// result doesn't depend on scheduling
+
+static const NSInteger kJNTParallelDecodeRangeSize = 1024;
+
+bool JNTDocumentDecodeArrayInParallel(JNTDecoder array, NSInteger workerCount, void (^callback)(NSInteger index, JNTDecoder element)) {
+    JNTContext *context = array.context;
+    NSInteger count = JNTDocumentGetArrayCount(array);
+    if (count == 0) {
+        return true;
+    }
+    if (workerCount <= 0) {
+        workerCount = std::max<NSInteger>(std::thread::hardware_concurrency(), 1);
+    }
+    // On-demand documents unescape strings in place the first time they're read, so they get a single worker
+    if (JNTLazyDocumentFrom(array.element)) {
+        workerCount = 1;
+    }
+    std::vector<JNTArrayIterator> rangeStarts;
+    JNTArrayIterator iterator = JNTDocumentGetIterator(array);
+    for (NSInteger i = 0; i < count; i++) {
+        if (i % kJNTParallelDecodeRangeSize == 0) {
+            rangeStarts.push_back(iterator);
+        }
+        JNTAdvanceIterator(&iterator, array);
+    }
+    NSInteger rangeCount = rangeStarts.size();
+    workerCount = std::min(workerCount, rangeCount);
+    std::vector<std::unique_ptr<JNTContext>> workerContexts;
+    std::vector<NSInteger> errorIndexes(workerCount, NSIntegerMax);
+    for (NSInteger i = 0; i < workerCount; i++) {
+        workerContexts.emplace_back(JNTCreateSharingContext(context));
+    }
+    // dispatch_apply returns once every worker is done, so the block can point to things on the stack
+    std::atomic<NSInteger> nextRange(0);
+    std::atomic<NSInteger> firstErrorIndex(NSIntegerMax);
+    std::atomic<NSInteger> *nextRangePtr = &nextRange;
+    std::atomic<NSInteger> *firstErrorIndexPtr = &firstErrorIndex;
+    std::vector<std::unique_ptr<JNTContext>> *workerContextsPtr = &workerContexts;
+    std::vector<NSInteger> *errorIndexesPtr = &errorIndexes;
+    std::vector<JNTArrayIterator> *rangeStartsPtr = &rangeStarts;
+    dispatch_apply(workerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker) {
+        JNTContext *workerContext = (*workerContextsPtr)[worker].get();
+        JNTDecoder workerArray = JNTCreateDecoder(array.element, workerContext, array.depth);
+        while (true) {
+            NSInteger range = nextRangePtr->fetch_add(1);
+            NSInteger start = range * kJNTParallelDecodeRangeSize;
+            if (range >= rangeCount || start > firstErrorIndexPtr->load()) {
+                return;
+            }
+            NSInteger end = std::min(start + kJNTParallelDecodeRangeSize, count);
+            JNTArrayIterator elementIterator = (*rangeStartsPtr)[range];
+            for (NSInteger i = start; i < end; i++) {
+                callback(i, JNTDecoderFromIterator(&elementIterator, workerArray));
+                if (JNT_UNLIKELY(JNTErrorDidOccur(workerContext))) {
+                    // Ranges are taken in order, so nothing this worker does later could have a lower index
+                    (*errorIndexesPtr)[worker] = i;
+                    NSInteger current = firstErrorIndexPtr->load();
+                    while (i < current && !firstErrorIndexPtr->compare_exchange_weak(current, i)) {
+                    }
+                    return;
+                }
+                JNTAdvanceIterator(&elementIterator, workerArray);
+            }
+        }
+    });
+    NSInteger firstErrorWorker = -1;
+    for (NSInteger i = 0; i < workerCount; i++) {
+        JNTDecodeStats &workerStats = workerContexts[i]->stats;
+        context->stats.lookups += workerStats.lookups;
+        context->stats.rewinds += workerStats.rewinds;
+        context->stats.fieldsRead += workerStats.fieldsRead;
+        if (errorIndexes[i] != NSIntegerMax && (firstErrorWorker < 0 || errorIndexes[i] < errorIndexes[firstErrorWorker])) {
+            firstErrorWorker = i;
+        }
+    }
+    if (firstErrorWorker < 0) {
+        return true;
+    }
+    JNTDecodingError error = workerContexts[firstErrorWorker]->error;
+    // The worker context is about to go away
+    error.value.context = context;
+    JNTSetError(error.description, error.type, context, error.value, error.key);
+    return false;
 }
 
-ENUMERATE(DECODE);
-
 // The following code is from simdjson.cpp. It was merged into this file, however,
 // to avoid a strange linker warning - https://github.com/michaeleisel/ZippyJSON/issues/41
 
@@ -4465,8 +7375,19 @@ public:
   template<size_t STEP_SIZE>
   static error_code index(const uint8_t *buf, size_t len, dom_parser_implementation &parser, stage1_mode partial) noexcept;
 
+  /**
+   * index() for a document that arrives in pieces. The indexer is kept in the parser between calls,
+   * and each 64-byte block is indexed as soon as the byte after it has arrived (the last block is
+   * padded with spaces, as in index()).
+   */
+  static error_code index_start(dom_parser_implementation &parser) noexcept;
+  static error_code index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+  static error_code index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+
 private:
+  friend struct incremental_indexer;
   simdjson_inline json_structural_indexer(uint32_t *structural_indexes);
+  simdjson_inline void step_at(const uint8_t *block, size_t idx) noexcept;
   template<size_t STEP_SIZE>
   simdjson_inline void step(const uint8_t *block, buf_block_reader<STEP_SIZE> &reader) noexcept;
   simdjson_inline void next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx);
@@ -4474,6 +7395,7 @@ private:
 
   json_scanner scanner{};
   utf8_checker checker{};
+  bool validate_utf8{true};
   bit_indexer indexer;
   uint64_t prev_structurals = 0;
   uint64_t unescaped_chars_error = 0;
@@ -4481,6 +7403,13 @@ private:
 
 simdjson_inline json_structural_indexer::json_structural_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
 
+// An indexer between calls to index_next(), and where its next block starts
+struct incremental_indexer final : internal::incremental_stage1 {
+  json_structural_indexer indexer;
+  size_t idx{0};
+  simdjson_inline incremental_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
+};
+
 // Skip the last character if it is partial
 simdjson_inline size_t trim_partial_utf8(const uint8_t *buf, size_t len) {
   if (simdjson_unlikely(len < 3)) {
@@ -4533,6 +7462,7 @@ error_code json_structural_indexer::index(const uint8_t *buf, size_t len, dom_pa
   }
   buf_block_reader<STEP_SIZE> reader(buf, len);
   json_structural_indexer indexer(parser.structural_indexes.get());
+  indexer.validate_utf8 = parser.validate_utf8;
 
   // Read all but the last block
   while (reader.has_full_block()) {
@@ -4565,9 +7495,50 @@ simdjson_inline void json_structural_indexer::step<64>(const uint8_t *block, buf
   reader.advance();
 }
 
+simdjson_inline void json_structural_indexer::step_at(const uint8_t *block, size_t idx) noexcept {
+  simd::simd8x64<uint8_t> in(block);
+  json_block json = scanner.next(in);
+  this->next(in, json, idx);
+}
+
+error_code json_structural_indexer::index_start(dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = new (std::nothrow) incremental_indexer(parser.structural_indexes.get());
+  if (!state) { return MEMALLOC; }
+  state->indexer.validate_utf8 = parser.validate_utf8;
+  parser.incremental_stage1_state.reset(state);
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = static_cast<incremental_indexer *>(parser.incremental_stage1_state.get());
+  if (!state) { return UNINITIALIZED; }
+  if (simdjson_unlikely(len > parser.capacity())) { return CAPACITY; }
+  // As with buf_block_reader, the last block is left for the end even when it's full
+  while (state->idx + 64 < len) {
+    state->indexer.step_at(buf + state->idx, state->idx);
+    state->idx += 64;
+  }
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  error_code error = index_next(buf, len, parser);
+  if (error) { return error; }
+  // Whatever happens, the document is done with
+  std::unique_ptr<internal::incremental_stage1> owner = std::move(parser.incremental_stage1_state);
+  incremental_indexer *state = static_cast<incremental_indexer *>(owner.get());
+  if (len == 0) { return EMPTY; }
+  uint8_t block[64];
+  std::memset(block, 0x20, 64);
+  std::memcpy(block, buf + state->idx, len - state->idx);
+  state->indexer.step_at(block, state->idx);
+  return state->indexer.finish(parser, state->idx + 64, len, stage1_mode::regular);
+}
+
 simdjson_inline void json_structural_indexer::next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx) {
   uint64_t unescaped = in.lteq(0x1F);
-  checker.check_next_input(in);
+  // With validation off, the checker never sees any input, so it has no errors at the end either
+  if (simdjson_likely(validate_utf8)) { checker.check_next_input(in); }
   indexer.write(uint32_t(idx-64), prev_structurals); // Output *last* iteration's structurals to the parser
   prev_structurals = block.structural_start();
   unescaped_chars_error |= block.non_quote_inside_string(unescaped);
@@ -5684,9 +8655,24 @@ simdjson_warn_unused error_code implementation::minify(const uint8_t *buf, size_
 simdjson_warn_unused error_code dom_parser_implementation::stage1(const uint8_t *_buf, size_t _len, stage1_mode streaming) noexcept {
   this->buf = _buf;
   this->len = _len;
+  incremental_stage1_state.reset();
   return arm64::stage1::json_structural_indexer::index<64>(buf, len, *this, streaming);
 }
 
+simdjson_warn_unused error_code dom_parser_implementation::stage1_start() noexcept {
+  return arm64::stage1::json_structural_indexer::index_start(*this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_next(const uint8_t *_buf, size_t _len) noexcept {
+  return arm64::stage1::json_structural_indexer::index_next(_buf, _len, *this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_end(const uint8_t *_buf, size_t _len) noexcept {
+  this->buf = _buf;
+  this->len = _len;
+  return arm64::stage1::json_structural_indexer::index_end(_buf, _len, *this);
+}
+
 simdjson_warn_unused bool implementation::validate_utf8(const char *buf, size_t len) const noexcept {
   return arm64::stage1::generic_validate_utf8(buf,len);
 }
@@ -5860,7 +8846,8 @@ class structural_scanner {
 public:
 
 simdjson_inline structural_scanner(dom_parser_implementation &_parser, stage1_mode _partial)
-  : buf{_parser.buf},
+  : non_ascii{_parser.validate_utf8 ? SWAR_HIGH_BITS : 0},
+    buf{_parser.buf},
     next_structural_index{_parser.structural_indexes.get()},
     parser{_parser},
     len{static_cast<uint32_t>(_parser.len)},
@@ -5937,13 +8924,64 @@ simdjson_inline void validate_utf8_character() {
   idx += 4;
 }
 
+// SWAR (8 bytes at a time in a uint64_t) helpers for the byte-at-a-time scanner. Each mask has the high bit
+// of a byte set when the byte matches, and no carries cross between bytes, so the masks are exact.
+static constexpr uint64_t SWAR_ONES = 0x0101010101010101ULL;
+static constexpr uint64_t SWAR_LOW_BITS = 0x7f7f7f7f7f7f7f7fULL;
+static constexpr uint64_t SWAR_HIGH_BITS = 0x8080808080808080ULL;
+
+simdjson_inline uint64_t swar_load(const uint8_t *src) {
+  uint64_t word;
+  std::memcpy(&word, src, sizeof(word));
+  return word;
+}
+
+// The index of the first byte (in memory order) that's set in a non-zero mask
+simdjson_inline uint32_t swar_first(uint64_t mask) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return uint32_t(__builtin_clzll(mask)) / 8;
+#else
+  return uint32_t(__builtin_ctzll(mask)) / 8;
+#endif
+}
+
+simdjson_inline uint64_t swar_nonzero(uint64_t word) {
+  return (((word & SWAR_LOW_BITS) + SWAR_LOW_BITS) | word) & SWAR_HIGH_BITS;
+}
+
+simdjson_inline uint64_t swar_equal_to(uint64_t word, uint8_t c) {
+  return ~swar_nonzero(word ^ (SWAR_ONES * c)) & SWAR_HIGH_BITS;
+}
+
+// For n <= 0x80
+simdjson_inline uint64_t swar_less_than(uint64_t word, uint8_t n) {
+  return ~(((word & SWAR_LOW_BITS) + SWAR_ONES * (0x80 - n)) | word) & SWAR_HIGH_BITS;
+}
+
+// Bytes in a string that need a closer look: quotes, backslashes, control characters and non-ASCII
+simdjson_inline uint64_t swar_string_special(uint64_t word) {
+  return swar_equal_to(word, '"') | swar_equal_to(word, '\\') | swar_less_than(word, 0x20) | (word & non_ascii);
+}
+
 // Returns true if the string is unclosed.
 simdjson_inline bool validate_string() {
   idx++; // skip first quote
   while (idx < len && buf[idx] != '"') {
+    if (idx + 8 <= len) {
+      uint64_t special = swar_string_special(swar_load(buf + idx));
+      if (special == 0) {
+        idx += 8;
+        continue;
+      }
+      uint32_t skip = swar_first(special);
+      if (skip > 0) {
+        idx += skip;
+        continue;
+      }
+    }
     if (buf[idx] == '\\') {
       idx += 2;
-    } else if (simdjson_unlikely(buf[idx] & 0x80)) {
+    } else if (simdjson_unlikely((buf[idx] & 0x80) && non_ascii)) {
       validate_utf8_character();
     } else {
       if (buf[idx] < 0x20) { error = UNESCAPED_CHARS; }
@@ -5982,6 +9020,11 @@ simdjson_inline error_code scan() {
         break;
       // Whitespace
       case ' ': case '\r': case '\n': case '\t':
+        // Skip the rest of a run of spaces, e.g. indentation
+        if (idx + 9 <= len) {
+          uint64_t not_space = swar_nonzero(swar_load(buf + idx + 1) ^ (SWAR_ONES * ' '));
+          idx += not_space ? swar_first(not_space) : 8;
+        }
         break;
       // Primitive or invalid character (invalid characters will be checked in stage 2)
       default:
@@ -6048,6 +9091,8 @@ simdjson_inline error_code scan() {
 }
 
 private:
+  // The high bits, or nothing if UTF-8 isn't being validated
+  uint64_t non_ascii;
   const uint8_t *buf;
   uint32_t *next_structural_index;
   dom_parser_implementation &parser;
@@ -6063,6 +9108,7 @@ private:
 simdjson_warn_unused error_code dom_parser_implementation::stage1(const uint8_t *_buf, size_t _len, stage1_mode partial) noexcept {
   this->buf = _buf;
   this->len = _len;
+  incremental_stage1_state.reset();
   stage1::structural_scanner scanner(*this, partial);
   return scanner.scan();
 }
@@ -8241,8 +11287,19 @@ public:
   template<size_t STEP_SIZE>
   static error_code index(const uint8_t *buf, size_t len, dom_parser_implementation &parser, stage1_mode partial) noexcept;
 
+  /**
+   * index() for a document that arrives in pieces. The indexer is kept in the parser between calls,
+   * and each 64-byte block is indexed as soon as the byte after it has arrived (the last block is
+   * padded with spaces, as in index()).
+   */
+  static error_code index_start(dom_parser_implementation &parser) noexcept;
+  static error_code index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+  static error_code index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+
 private:
+  friend struct incremental_indexer;
   simdjson_inline json_structural_indexer(uint32_t *structural_indexes);
+  simdjson_inline void step_at(const uint8_t *block, size_t idx) noexcept;
   template<size_t STEP_SIZE>
   simdjson_inline void step(const uint8_t *block, buf_block_reader<STEP_SIZE> &reader) noexcept;
   simdjson_inline void next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx);
@@ -8250,6 +11307,7 @@ private:
 
   json_scanner scanner{};
   utf8_checker checker{};
+  bool validate_utf8{true};
   bit_indexer indexer;
   uint64_t prev_structurals = 0;
   uint64_t unescaped_chars_error = 0;
@@ -8257,6 +11315,13 @@ private:
 
 simdjson_inline json_structural_indexer::json_structural_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
 
+// An indexer between calls to index_next(), and where its next block starts
+struct incremental_indexer final : internal::incremental_stage1 {
+  json_structural_indexer indexer;
+  size_t idx{0};
+  simdjson_inline incremental_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
+};
+
 // Skip the last character if it is partial
 simdjson_inline size_t trim_partial_utf8(const uint8_t *buf, size_t len) {
   if (simdjson_unlikely(len < 3)) {
@@ -8309,6 +11374,7 @@ error_code json_structural_indexer::index(const uint8_t *buf, size_t len, dom_pa
   }
   buf_block_reader<STEP_SIZE> reader(buf, len);
   json_structural_indexer indexer(parser.structural_indexes.get());
+  indexer.validate_utf8 = parser.validate_utf8;
 
   // Read all but the last block
   while (reader.has_full_block()) {
@@ -8341,9 +11407,50 @@ simdjson_inline void json_structural_indexer::step<64>(const uint8_t *block, buf
   reader.advance();
 }
 
+simdjson_inline void json_structural_indexer::step_at(const uint8_t *block, size_t idx) noexcept {
+  simd::simd8x64<uint8_t> in(block);
+  json_block json = scanner.next(in);
+  this->next(in, json, idx);
+}
+
+error_code json_structural_indexer::index_start(dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = new (std::nothrow) incremental_indexer(parser.structural_indexes.get());
+  if (!state) { return MEMALLOC; }
+  state->indexer.validate_utf8 = parser.validate_utf8;
+  parser.incremental_stage1_state.reset(state);
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = static_cast<incremental_indexer *>(parser.incremental_stage1_state.get());
+  if (!state) { return UNINITIALIZED; }
+  if (simdjson_unlikely(len > parser.capacity())) { return CAPACITY; }
+  // As with buf_block_reader, the last block is left for the end even when it's full
+  while (state->idx + 64 < len) {
+    state->indexer.step_at(buf + state->idx, state->idx);
+    state->idx += 64;
+  }
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  error_code error = index_next(buf, len, parser);
+  if (error) { return error; }
+  // Whatever happens, the document is done with
+  std::unique_ptr<internal::incremental_stage1> owner = std::move(parser.incremental_stage1_state);
+  incremental_indexer *state = static_cast<incremental_indexer *>(owner.get());
+  if (len == 0) { return EMPTY; }
+  uint8_t block[64];
+  std::memset(block, 0x20, 64);
+  std::memcpy(block, buf + state->idx, len - state->idx);
+  state->indexer.step_at(block, state->idx);
+  return state->indexer.finish(parser, state->idx + 64, len, stage1_mode::regular);
+}
+
 simdjson_inline void json_structural_indexer::next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx) {
   uint64_t unescaped = in.lteq(0x1F);
-  checker.check_next_input(in);
+  // With validation off, the checker never sees any input, so it has no errors at the end either
+  if (simdjson_likely(validate_utf8)) { checker.check_next_input(in); }
   indexer.write(uint32_t(idx-64), prev_structurals); // Output *last* iteration's structurals to the parser
   prev_structurals = block.structural_start();
   unescaped_chars_error |= block.non_quote_inside_string(unescaped);
@@ -9504,9 +12611,24 @@ simdjson_warn_unused error_code implementation::minify(const uint8_t *buf, size_
 simdjson_warn_unused error_code dom_parser_implementation::stage1(const uint8_t *_buf, size_t _len, stage1_mode streaming) noexcept {
   this->buf = _buf;
   this->len = _len;
+  incremental_stage1_state.reset();
   return icelake::stage1::json_structural_indexer::index<128>(_buf, _len, *this, streaming);
 }
 
+simdjson_warn_unused error_code dom_parser_implementation::stage1_start() noexcept {
+  return icelake::stage1::json_structural_indexer::index_start(*this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_next(const uint8_t *_buf, size_t _len) noexcept {
+  return icelake::stage1::json_structural_indexer::index_next(_buf, _len, *this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_end(const uint8_t *_buf, size_t _len) noexcept {
+  this->buf = _buf;
+  this->len = _len;
+  return icelake::stage1::json_structural_indexer::index_end(_buf, _len, *this);
+}
+
 simdjson_warn_unused bool implementation::validate_utf8(const char *buf, size_t len) const noexcept {
   return icelake::stage1::generic_validate_utf8(buf,len);
 }
@@ -10620,8 +13742,19 @@ public:
   template<size_t STEP_SIZE>
   static error_code index(const uint8_t *buf, size_t len, dom_parser_implementation &parser, stage1_mode partial) noexcept;
 
+  /**
+   * index() for a document that arrives in pieces. The indexer is kept in the parser between calls,
+   * and each 64-byte block is indexed as soon as the byte after it has arrived (the last block is
+   * padded with spaces, as in index()).
+   */
+  static error_code index_start(dom_parser_implementation &parser) noexcept;
+  static error_code index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+  static error_code index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+
 private:
+  friend struct incremental_indexer;
   simdjson_inline json_structural_indexer(uint32_t *structural_indexes);
+  simdjson_inline void step_at(const uint8_t *block, size_t idx) noexcept;
   template<size_t STEP_SIZE>
   simdjson_inline void step(const uint8_t *block, buf_block_reader<STEP_SIZE> &reader) noexcept;
   simdjson_inline void next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx);
@@ -10629,6 +13762,7 @@ private:
 
   json_scanner scanner{};
   utf8_checker checker{};
+  bool validate_utf8{true};
   bit_indexer indexer;
   uint64_t prev_structurals = 0;
   uint64_t unescaped_chars_error = 0;
@@ -10636,6 +13770,13 @@ private:
 
 simdjson_inline json_structural_indexer::json_structural_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
 
+// An indexer between calls to index_next(), and where its next block starts
+struct incremental_indexer final : internal::incremental_stage1 {
+  json_structural_indexer indexer;
+  size_t idx{0};
+  simdjson_inline incremental_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
+};
+
 // Skip the last character if it is partial
 simdjson_inline size_t trim_partial_utf8(const uint8_t *buf, size_t len) {
   if (simdjson_unlikely(len < 3)) {
@@ -10688,6 +13829,7 @@ error_code json_structural_indexer::index(const uint8_t *buf, size_t len, dom_pa
   }
   buf_block_reader<STEP_SIZE> reader(buf, len);
   json_structural_indexer indexer(parser.structural_indexes.get());
+  indexer.validate_utf8 = parser.validate_utf8;
 
   // Read all but the last block
   while (reader.has_full_block()) {
@@ -10720,9 +13862,50 @@ simdjson_inline void json_structural_indexer::step<64>(const uint8_t *block, buf
   reader.advance();
 }
 
+simdjson_inline void json_structural_indexer::step_at(const uint8_t *block, size_t idx) noexcept {
+  simd::simd8x64<uint8_t> in(block);
+  json_block json = scanner.next(in);
+  this->next(in, json, idx);
+}
+
+error_code json_structural_indexer::index_start(dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = new (std::nothrow) incremental_indexer(parser.structural_indexes.get());
+  if (!state) { return MEMALLOC; }
+  state->indexer.validate_utf8 = parser.validate_utf8;
+  parser.incremental_stage1_state.reset(state);
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = static_cast<incremental_indexer *>(parser.incremental_stage1_state.get());
+  if (!state) { return UNINITIALIZED; }
+  if (simdjson_unlikely(len > parser.capacity())) { return CAPACITY; }
+  // As with buf_block_reader, the last block is left for the end even when it's full
+  while (state->idx + 64 < len) {
+    state->indexer.step_at(buf + state->idx, state->idx);
+    state->idx += 64;
+  }
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  error_code error = index_next(buf, len, parser);
+  if (error) { return error; }
+  // Whatever happens, the document is done with
+  std::unique_ptr<internal::incremental_stage1> owner = std::move(parser.incremental_stage1_state);
+  incremental_indexer *state = static_cast<incremental_indexer *>(owner.get());
+  if (len == 0) { return EMPTY; }
+  uint8_t block[64];
+  std::memset(block, 0x20, 64);
+  std::memcpy(block, buf + state->idx, len - state->idx);
+  state->indexer.step_at(block, state->idx);
+  return state->indexer.finish(parser, state->idx + 64, len, stage1_mode::regular);
+}
+
 simdjson_inline void json_structural_indexer::next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx) {
   uint64_t unescaped = in.lteq(0x1F);
-  checker.check_next_input(in);
+  // With validation off, the checker never sees any input, so it has no errors at the end either
+  if (simdjson_likely(validate_utf8)) { checker.check_next_input(in); }
   indexer.write(uint32_t(idx-64), prev_structurals); // Output *last* iteration's structurals to the parser
   prev_structurals = block.structural_start();
   unescaped_chars_error |= block.non_quote_inside_string(unescaped);
@@ -11836,9 +15019,24 @@ simdjson_warn_unused error_code implementation::minify(const uint8_t *buf, size_
 simdjson_warn_unused error_code dom_parser_implementation::stage1(const uint8_t *_buf, size_t _len, stage1_mode streaming) noexcept {
   this->buf = _buf;
   this->len = _len;
+  incremental_stage1_state.reset();
   return haswell::stage1::json_structural_indexer::index<128>(_buf, _len, *this, streaming);
 }
 
+simdjson_warn_unused error_code dom_parser_implementation::stage1_start() noexcept {
+  return haswell::stage1::json_structural_indexer::index_start(*this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_next(const uint8_t *_buf, size_t _len) noexcept {
+  return haswell::stage1::json_structural_indexer::index_next(_buf, _len, *this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_end(const uint8_t *_buf, size_t _len) noexcept {
+  this->buf = _buf;
+  this->len = _len;
+  return haswell::stage1::json_structural_indexer::index_end(_buf, _len, *this);
+}
+
 simdjson_warn_unused bool implementation::validate_utf8(const char *buf, size_t len) const noexcept {
   return haswell::stage1::generic_validate_utf8(buf,len);
 }
@@ -12915,8 +16113,19 @@ public:
   template<size_t STEP_SIZE>
   static error_code index(const uint8_t *buf, size_t len, dom_parser_implementation &parser, stage1_mode partial) noexcept;
 
+  /**
+   * index() for a document that arrives in pieces. The indexer is kept in the parser between calls,
+   * and each 64-byte block is indexed as soon as the byte after it has arrived (the last block is
+   * padded with spaces, as in index()).
+   */
+  static error_code index_start(dom_parser_implementation &parser) noexcept;
+  static error_code index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+  static error_code index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+
 private:
+  friend struct incremental_indexer;
   simdjson_inline json_structural_indexer(uint32_t *structural_indexes);
+  simdjson_inline void step_at(const uint8_t *block, size_t idx) noexcept;
   template<size_t STEP_SIZE>
   simdjson_inline void step(const uint8_t *block, buf_block_reader<STEP_SIZE> &reader) noexcept;
   simdjson_inline void next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx);
@@ -12924,6 +16133,7 @@ private:
 
   json_scanner scanner{};
   utf8_checker checker{};
+  bool validate_utf8{true};
   bit_indexer indexer;
   uint64_t prev_structurals = 0;
   uint64_t unescaped_chars_error = 0;
@@ -12931,6 +16141,13 @@ private:
 
 simdjson_inline json_structural_indexer::json_structural_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
 
+// An indexer between calls to index_next(), and where its next block starts
+struct incremental_indexer final : internal::incremental_stage1 {
+  json_structural_indexer indexer;
+  size_t idx{0};
+  simdjson_inline incremental_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
+};
+
 // Skip the last character if it is partial
 simdjson_inline size_t trim_partial_utf8(const uint8_t *buf, size_t len) {
   if (simdjson_unlikely(len < 3)) {
@@ -12983,6 +16200,7 @@ error_code json_structural_indexer::index(const uint8_t *buf, size_t len, dom_pa
   }
   buf_block_reader<STEP_SIZE> reader(buf, len);
   json_structural_indexer indexer(parser.structural_indexes.get());
+  indexer.validate_utf8 = parser.validate_utf8;
 
   // Read all but the last block
   while (reader.has_full_block()) {
@@ -13015,9 +16233,50 @@ simdjson_inline void json_structural_indexer::step<64>(const uint8_t *block, buf
   reader.advance();
 }
 
+simdjson_inline void json_structural_indexer::step_at(const uint8_t *block, size_t idx) noexcept {
+  simd::simd8x64<uint8_t> in(block);
+  json_block json = scanner.next(in);
+  this->next(in, json, idx);
+}
+
+error_code json_structural_indexer::index_start(dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = new (std::nothrow) incremental_indexer(parser.structural_indexes.get());
+  if (!state) { return MEMALLOC; }
+  state->indexer.validate_utf8 = parser.validate_utf8;
+  parser.incremental_stage1_state.reset(state);
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = static_cast<incremental_indexer *>(parser.incremental_stage1_state.get());
+  if (!state) { return UNINITIALIZED; }
+  if (simdjson_unlikely(len > parser.capacity())) { return CAPACITY; }
+  // As with buf_block_reader, the last block is left for the end even when it's full
+  while (state->idx + 64 < len) {
+    state->indexer.step_at(buf + state->idx, state->idx);
+    state->idx += 64;
+  }
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  error_code error = index_next(buf, len, parser);
+  if (error) { return error; }
+  // Whatever happens, the document is done with
+  std::unique_ptr<internal::incremental_stage1> owner = std::move(parser.incremental_stage1_state);
+  incremental_indexer *state = static_cast<incremental_indexer *>(owner.get());
+  if (len == 0) { return EMPTY; }
+  uint8_t block[64];
+  std::memset(block, 0x20, 64);
+  std::memcpy(block, buf + state->idx, len - state->idx);
+  state->indexer.step_at(block, state->idx);
+  return state->indexer.finish(parser, state->idx + 64, len, stage1_mode::regular);
+}
+
 simdjson_inline void json_structural_indexer::next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx) {
   uint64_t unescaped = in.lteq(0x1F);
-  checker.check_next_input(in);
+  // With validation off, the checker never sees any input, so it has no errors at the end either
+  if (simdjson_likely(validate_utf8)) { checker.check_next_input(in); }
   indexer.write(uint32_t(idx-64), prev_structurals); // Output *last* iteration's structurals to the parser
   prev_structurals = block.structural_start();
   unescaped_chars_error |= block.non_quote_inside_string(unescaped);
@@ -14133,9 +17392,24 @@ simdjson_warn_unused error_code implementation::minify(const uint8_t *buf, size_
 simdjson_warn_unused error_code dom_parser_implementation::stage1(const uint8_t *_buf, size_t _len, stage1_mode streaming) noexcept {
   this->buf = _buf;
   this->len = _len;
+  incremental_stage1_state.reset();
   return ppc64::stage1::json_structural_indexer::index<64>(buf, len, *this, streaming);
 }
 
+simdjson_warn_unused error_code dom_parser_implementation::stage1_start() noexcept {
+  return ppc64::stage1::json_structural_indexer::index_start(*this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_next(const uint8_t *_buf, size_t _len) noexcept {
+  return ppc64::stage1::json_structural_indexer::index_next(_buf, _len, *this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_end(const uint8_t *_buf, size_t _len) noexcept {
+  this->buf = _buf;
+  this->len = _len;
+  return ppc64::stage1::json_structural_indexer::index_end(_buf, _len, *this);
+}
+
 simdjson_warn_unused bool implementation::validate_utf8(const char *buf, size_t len) const noexcept {
   return ppc64::stage1::generic_validate_utf8(buf,len);
 }
@@ -15245,8 +18519,19 @@ public:
   template<size_t STEP_SIZE>
   static error_code index(const uint8_t *buf, size_t len, dom_parser_implementation &parser, stage1_mode partial) noexcept;
 
+  /**
+   * index() for a document that arrives in pieces. The indexer is kept in the parser between calls,
+   * and each 64-byte block is indexed as soon as the byte after it has arrived (the last block is
+   * padded with spaces, as in index()).
+   */
+  static error_code index_start(dom_parser_implementation &parser) noexcept;
+  static error_code index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+  static error_code index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept;
+
 private:
+  friend struct incremental_indexer;
   simdjson_inline json_structural_indexer(uint32_t *structural_indexes);
+  simdjson_inline void step_at(const uint8_t *block, size_t idx) noexcept;
   template<size_t STEP_SIZE>
   simdjson_inline void step(const uint8_t *block, buf_block_reader<STEP_SIZE> &reader) noexcept;
   simdjson_inline void next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx);
@@ -15254,6 +18539,7 @@ private:
 
   json_scanner scanner{};
   utf8_checker checker{};
+  bool validate_utf8{true};
   bit_indexer indexer;
   uint64_t prev_structurals = 0;
   uint64_t unescaped_chars_error = 0;
@@ -15261,6 +18547,13 @@ private:
 
 simdjson_inline json_structural_indexer::json_structural_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
 
+// An indexer between calls to index_next(), and where its next block starts
+struct incremental_indexer final : internal::incremental_stage1 {
+  json_structural_indexer indexer;
+  size_t idx{0};
+  simdjson_inline incremental_indexer(uint32_t *structural_indexes) : indexer{structural_indexes} {}
+};
+
 // Skip the last character if it is partial
 simdjson_inline size_t trim_partial_utf8(const uint8_t *buf, size_t len) {
   if (simdjson_unlikely(len < 3)) {
@@ -15313,6 +18606,7 @@ error_code json_structural_indexer::index(const uint8_t *buf, size_t len, dom_pa
   }
   buf_block_reader<STEP_SIZE> reader(buf, len);
   json_structural_indexer indexer(parser.structural_indexes.get());
+  indexer.validate_utf8 = parser.validate_utf8;
 
   // Read all but the last block
   while (reader.has_full_block()) {
@@ -15345,9 +18639,50 @@ simdjson_inline void json_structural_indexer::step<64>(const uint8_t *block, buf
   reader.advance();
 }
 
+simdjson_inline void json_structural_indexer::step_at(const uint8_t *block, size_t idx) noexcept {
+  simd::simd8x64<uint8_t> in(block);
+  json_block json = scanner.next(in);
+  this->next(in, json, idx);
+}
+
+error_code json_structural_indexer::index_start(dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = new (std::nothrow) incremental_indexer(parser.structural_indexes.get());
+  if (!state) { return MEMALLOC; }
+  state->indexer.validate_utf8 = parser.validate_utf8;
+  parser.incremental_stage1_state.reset(state);
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_next(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  incremental_indexer *state = static_cast<incremental_indexer *>(parser.incremental_stage1_state.get());
+  if (!state) { return UNINITIALIZED; }
+  if (simdjson_unlikely(len > parser.capacity())) { return CAPACITY; }
+  // As with buf_block_reader, the last block is left for the end even when it's full
+  while (state->idx + 64 < len) {
+    state->indexer.step_at(buf + state->idx, state->idx);
+    state->idx += 64;
+  }
+  return SUCCESS;
+}
+
+error_code json_structural_indexer::index_end(const uint8_t *buf, size_t len, dom_parser_implementation &parser) noexcept {
+  error_code error = index_next(buf, len, parser);
+  if (error) { return error; }
+  // Whatever happens, the document is done with
+  std::unique_ptr<internal::incremental_stage1> owner = std::move(parser.incremental_stage1_state);
+  incremental_indexer *state = static_cast<incremental_indexer *>(owner.get());
+  if (len == 0) { return EMPTY; }
+  uint8_t block[64];
+  std::memset(block, 0x20, 64);
+  std::memcpy(block, buf + state->idx, len - state->idx);
+  state->indexer.step_at(block, state->idx);
+  return state->indexer.finish(parser, state->idx + 64, len, stage1_mode::regular);
+}
+
 simdjson_inline void json_structural_indexer::next(const simd::simd8x64<uint8_t>& in, const json_block& block, size_t idx) {
   uint64_t unescaped = in.lteq(0x1F);
-  checker.check_next_input(in);
+  // With validation off, the checker never sees any input, so it has no errors at the end either
+  if (simdjson_likely(validate_utf8)) { checker.check_next_input(in); }
   indexer.write(uint32_t(idx-64), prev_structurals); // Output *last* iteration's structurals to the parser
   prev_structurals = block.structural_start();
   unescaped_chars_error |= block.non_quote_inside_string(unescaped);
@@ -16462,9 +19797,24 @@ simdjson_warn_unused error_code implementation::minify(const uint8_t *buf, size_
 simdjson_warn_unused error_code dom_parser_implementation::stage1(const uint8_t *_buf, size_t _len, stage1_mode streaming) noexcept {
   this->buf = _buf;
   this->len = _len;
+  incremental_stage1_state.reset();
   return westmere::stage1::json_structural_indexer::index<64>(_buf, _len, *this, streaming);
 }
 
+simdjson_warn_unused error_code dom_parser_implementation::stage1_start() noexcept {
+  return westmere::stage1::json_structural_indexer::index_start(*this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_next(const uint8_t *_buf, size_t _len) noexcept {
+  return westmere::stage1::json_structural_indexer::index_next(_buf, _len, *this);
+}
+
+simdjson_warn_unused error_code dom_parser_implementation::stage1_end(const uint8_t *_buf, size_t _len) noexcept {
+  this->buf = _buf;
+  this->len = _len;
+  return westmere::stage1::json_structural_indexer::index_end(_buf, _len, *this);
+}
+
 simdjson_warn_unused bool implementation::validate_utf8(const char *buf, size_t len) const noexcept {
   return westmere::stage1::generic_validate_utf8(buf,len);
 }
@@ -10,8 +10,101 @@ typedef CF_ENUM(size_t, JNTDecodingErrorType) {
     JNTDecodingErrorTypeNumberDoesNotFit,
     JNTDecodingErrorTypeWrongType,
     JNTDecodingErrorTypeJSONParsingFailed,
+    JNTDecodingErrorTypeInvalidRawValue,
 };
 
+typedef CF_ENUM(size_t, JNTDecoderEngine) {
+    JNTDecoderEngineDOM,
+    JNTDecoderEngineOnDemand,
+    JNTDecoderEngineAutomatic,
+};
+
+// Fields read and present only cover the decodes where the number of fields present was counted, which is every DOM
+// decode and a sample of the on-demand ones
+typedef struct {
+    uint64_t decodeCount;
+    uint64_t onDemandDecodeCount;
+    uint64_t bytes;
+    uint64_t fieldsRead;
+    uint64_t fieldsPresent;
+    uint64_t lookups;
+    uint64_t rewinds;
+    JNTDecoderEngine nextEngine;
+} JNTDecoderEngineStats;
+
+typedef struct {
+    const void *data;
+    NSInteger length;
+} JNTSegment;
+
+// A string in the document, which is also null-terminated
+typedef struct {
+    const char *data;
+    NSInteger length;
+} JNTStringSpan;
+
+// simdjson's instruction_set flags
+typedef CF_OPTIONS(uint32_t, JNTInstructionSet) {
+    JNTInstructionSetNEON = 0x1,
+    JNTInstructionSetAVX2 = 0x4,
+    JNTInstructionSetSSE42 = 0x8,
+    JNTInstructionSetPCLMULQDQ = 0x10,
+    JNTInstructionSetBMI1 = 0x20,
+    JNTInstructionSetBMI2 = 0x40,
+    JNTInstructionSetAVX512F = 0x100,
+    JNTInstructionSetAVX512DQ = 0x200,
+    JNTInstructionSetAVX512CD = 0x2000,
+    JNTInstructionSetAVX512BW = 0x4000,
+    JNTInstructionSetAVX512VL = 0x8000,
+    JNTInstructionSetAVX512VBMI2 = 0x10000,
+};
+
+typedef struct {
+    const char *name;
+    const char *description;
+    JNTInstructionSet requiredInstructionSets;
+    // Whether this CPU supports it
+    bool supported;
+} JNTImplementationInfo;
+
+// The C type that a decode plan writes a field as
+typedef CF_ENUM(uint8_t, JNTFieldType) {
+    JNTFieldTypeBool,
+    JNTFieldTypeInt8,
+    JNTFieldTypeUInt8,
+    JNTFieldTypeInt16,
+    JNTFieldTypeUInt16,
+    JNTFieldTypeInt32,
+    JNTFieldTypeUInt32,
+    JNTFieldTypeInt64,
+    JNTFieldTypeUInt64,
+    JNTFieldTypeInt,
+    JNTFieldTypeUInt,
+    JNTFieldTypeFloat,
+    JNTFieldTypeDouble,
+    // A const char * that lives as long as the document
+    JNTFieldTypeString,
+};
+
+typedef struct {
+    const char *key;
+    JNTFieldType type;
+    // Where in the struct the value goes
+    NSInteger offset;
+    // Optional fields can be absent or null
+    bool isOptional;
+} JNTPlanField;
+
+// Bit i is for the plan's field i
+typedef struct {
+    // Written to the struct
+    uint64_t decoded;
+    // Required, but absent or null
+    uint64_t missing;
+    // The wrong type, or a number that doesn't fit
+    uint64_t mismatched;
+} JNTPlanResult;
+
 static const NSInteger kJNTDecoderSize = 25;
 
 #ifdef __cplusplus
@@ -23,6 +116,42 @@ struct ContextDummy {
 typedef struct ContextDummy *ContextPointer;
 #endif
 
+#ifdef __cplusplus
+struct JNTPipeline;
+typedef JNTPipeline *PipelinePointer;
+#else
+struct PipelineDummy {
+};
+typedef struct PipelineDummy *PipelinePointer;
+#endif
+
+#ifdef __cplusplus
+struct JNTKeySet;
+typedef JNTKeySet *KeySetPointer;
+#else
+struct KeySetDummy {
+};
+typedef struct KeySetDummy *KeySetPointer;
+#endif
+
+#ifdef __cplusplus
+struct JNTEnumTable;
+typedef JNTEnumTable *EnumTablePointer;
+#else
+struct EnumTableDummy {
+};
+typedef struct EnumTableDummy *EnumTablePointer;
+#endif
+
+#ifdef __cplusplus
+struct JNTPlan;
+typedef JNTPlan *PlanPointer;
+#else
+struct PlanDummy {
+};
+typedef struct PlanDummy *PlanPointer;
+#endif
+
 struct JNTElementStorage {
     void *doc;
     size_t offset;
@@ -76,8 +205,38 @@ bool JNTDocumentErrorDidOccur(JNTDecoder decoder);
 bool JNTDocumentValueIsInteger(JNTDecoder decoder);
 bool JNTDocumentValueIsDouble(JNTDecoder decoder);
 bool JNTHasVectorExtensions();
+JNTInstructionSet JNTGetDetectedInstructionSets();
+NSInteger JNTGetImplementations(JNTImplementationInfo *infos, NSInteger infoCapacity);
+void JNTGetActiveImplementation(ContextPointer context, JNTImplementationInfo *info);
+bool JNTSetImplementation(ContextPointer context, const char *name);
 ContextPointer JNTCreateContext(const char *originalString, uint32_t originalStringLength, const char *negInfString, const char *posInfString, const char *nanString, BOOL stringsForFloats);
+void JNTSetDecoderEngine(ContextPointer context, JNTDecoderEngine engine);
+void JNTSelectDecoderEngine(ContextPointer context, const void *modelType);
+void JNTSetDecoderEngineOverride(const void *modelType, JNTDecoderEngine engine);
+bool JNTGetDecoderEngineStats(const void *modelType, JNTDecoderEngineStats *stats);
+void JNTSetTrustedInput(ContextPointer context, bool trusted);
+bool JNTSetMaxDepth(ContextPointer context, NSInteger maxDepth);
+void JNTSetParallelParsing(ContextPointer context, NSInteger rangeCount, NSInteger minimumLength);
 JNTDecoder JNTDocumentFromJSON(ContextPointer context, const void *data, NSInteger length, bool convertCase, const char * *retryReason, bool *success);
+JNTDecoder JNTDocumentFromFile(ContextPointer context, const char *path, bool convertCase, const char * *retryReason, bool *success);
+bool JNTDocumentStreamFromJSON(ContextPointer context, const void *data, NSInteger length, size_t batchSize, size_t threadCount, const char * *retryReason);
+JNTDecoder JNTDocumentStreamNext(ContextPointer context, size_t *offset, bool *isAtEnd, const char * *retryReason, bool *success);
+void JNTDocumentStreamClose(ContextPointer context);
+bool JNTParserReserve(ContextPointer context, NSInteger expectedLength);
+bool JNTParserFeed(ContextPointer context, const void *chunk, NSInteger length);
+JNTDecoder JNTParserFinish(ContextPointer context, bool convertCase, const char * *retryReason, bool *success);
+JNTDecoder JNTDocumentFromSegments(ContextPointer context, const JNTSegment *segments, NSInteger count, bool convertCase, const char * *retryReason, bool *success);
+bool JNTDocumentsFromJSONBatch(ContextPointer *contexts, const JNTSegment *documents, NSInteger count, NSInteger threadCount, bool convertCase, JNTDecoder *roots, const char * *retryReasons, bool *successes);
+PipelinePointer JNTPipelineCreate(ContextPointer *contexts, NSInteger contextCount, bool convertCase);
+bool JNTPipelineSubmit(PipelinePointer pipeline, const void *data, NSInteger length);
+void JNTPipelineFinish(PipelinePointer pipeline);
+JNTDecoder JNTPipelineNext(PipelinePointer pipeline, ContextPointer *context, bool *isAtEnd, const char * *retryReason, bool *success);
+void JNTPipelineRecycle(PipelinePointer pipeline, ContextPointer context);
+void JNTPipelineCancel(PipelinePointer pipeline);
+void JNTPipelineRelease(PipelinePointer pipeline);
+bool JNTValidateJSON(const void *data, NSInteger length, NSInteger *errorOffset);
+ContextPointer JNTCreateReader(ContextPointer context);
+JNTDecoder JNTReaderGetRoot(ContextPointer reader);
 bool JNTDocumentContains(JNTDecoder decoder, const char *key, JNTDictionaryIterator *iteratorPtr);
 void JNTGetErrorInfo(ContextPointer context, JNTErrorInfo *info);
 bool JNTErrorDidOccur(ContextPointer context);
@@ -90,8 +249,22 @@ bool JNTDocumentValueIsDictionary(JNTDecoder iterator);
 NSArray <NSString *> *JNTDocumentAllKeys(JNTDecoder decoder);
 NSArray <id> *JNTDocumentCodingPath(JNTDecoder iterator);
 void JNTDocumentForAllKeyValuePairs(JNTDecoder iterator, void (^callback)(const char *key, JNTDecoder iterator));
+NSInteger JNTDocumentGetDictionaryCount(JNTDecoder decoder);
+bool JNTDocumentGetKeysAndValues(JNTDecoder decoder, JNTStringSpan *keys, JNTDecoder *values, NSInteger count);
 void JNTConvertSnakeToCamel(JNTDecoder iterator);
+KeySetPointer JNTKeySetCreate(const char * const *keys, NSInteger count);
+void JNTKeySetRelease(KeySetPointer keySet);
+uint64_t JNTDocumentFindKeys(JNTDecoder decoder, KeySetPointer keySet, JNTDecoder *values);
+NSInteger JNTDocumentPeekDiscriminator(JNTDecoder decoder, const char *key, KeySetPointer candidates);
+EnumTablePointer JNTEnumTableCreate(const char * const *rawValues, NSInteger count);
+void JNTEnumTableRelease(EnumTablePointer table);
+NSInteger JNTDocumentDecodeEnum(JNTDecoder value, EnumTablePointer table);
+bool JNTDocumentDecodeEnumArray(JNTDecoder array, EnumTablePointer table, NSInteger *outIndexes, NSInteger count);
+PlanPointer JNTPlanCreate(const JNTPlanField *fields, NSInteger count);
+void JNTPlanRelease(PlanPointer plan);
+bool JNTDecodeWithPlan(JNTDecoder decoder, PlanPointer plan, void *outStruct, JNTPlanResult *result);
 void JNTAdvanceIterator(JNTArrayIterator *iterator, JNTDecoder root);
+bool JNTDocumentDecodeArrayInParallel(JNTDecoder array, NSInteger workerCount, void (^callback)(NSInteger index, JNTDecoder element));
 
 double JNTDocumentDecode__Double(JNTDecoder value);
 float JNTDocumentDecode__Float(JNTDecoder value);
@@ -117,7 +290,8 @@ NSInteger JNTDocumentGetArrayCount(JNTDecoder value);
 #define DECODE_KEYED_HEADER(A, B) DECODE_KEYED_HEADER_NAMED(A, B, A)
 
 #define DECODE_KEYED_HEADER_NAMED(A, B, C) \
-A JNTDocumentDecodeKeyed__##C(JNTDecoder value, const char *key);
+A JNTDocumentDecodeKeyed__##C(JNTDecoder value, const char *key, JNTDictionaryIterator *iteratorPtr); \
+A JNTDocumentDecodeKeyedIfPresent__##C(JNTDecoder value, const char *key, JNTDictionaryIterator *iteratorPtr, bool *isPresent, bool *isNull);
 
 #define DECODE_HEADER(A, B) DECODE_HEADER_NAMED(A, B, A)
 
@@ -126,6 +300,9 @@ A JNTDocumentDecode__##C(JNTDecoder value);
 
 #define DECODE_ITER_HEADER(A, B) DECODE_ITER_HEADER_NAMED(A, B, A)
 
+#define DECODE_ITER_HEADER_NAMED(A, B, C) \
+A JNTIteratorDecode__##C(JNTArrayIterator *iterator, JNTDecoder root, bool *isAtEnd);
+
 #define ENUMERATE(F) \
 F(int8_t, int64_t); \
 F(uint8_t, int64_t); \
@@ -143,5 +320,7 @@ F##_NAMED(double, double, Double); \
 F##_NAMED(float, double, Float);
 
 ENUMERATE(DECODE_HEADER);
+ENUMERATE(DECODE_KEYED_HEADER);
+ENUMERATE(DECODE_ITER_HEADER);
 
 CF_EXTERN_C_END
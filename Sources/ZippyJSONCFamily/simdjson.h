@@ -2883,6 +2883,12 @@ inline bool is_streaming(stage1_mode mode) {
 
 namespace internal {
 
+/**
+ * @private The state of an incremental stage 1 between calls, which each implementation extends
+ */
+struct incremental_stage1 {
+  virtual ~incremental_stage1() = default;
+};
 
 /**
  * An implementation of simdjson's DOM parser for a particular CPU architecture.
@@ -2924,6 +2930,27 @@ public:
    */
   simdjson_warn_unused virtual error_code stage1(const uint8_t *buf, size_t len, stage1_mode streaming) noexcept = 0;
 
+  /**
+   * @private For internal implementation use
+   *
+   * Stage 1 of the document parser, for a document that arrives in pieces. stage1_start() begins
+   * it, each stage1_next() call indexes as much of what has arrived as it can, and stage1_end()
+   * indexes the rest, with the same result as stage1(buf, len, stage1_mode::regular).
+   *
+   * The bytes passed to one call must be passed unchanged to the next, though buf can move. Anything
+   * else that reallocates this parser or runs stage 1 on it abandons the document, after which
+   * stage1_next() and stage1_end() return UNINITIALIZED.
+   *
+   * By default, everything is left to stage1_end().
+   *
+   * @param buf What has arrived so far. For stage1_end(), *MUST* be allocated up to len + SIMDJSON_PADDING bytes.
+   * @param len The length of what has arrived so far.
+   * @return The error code, or SUCCESS if there was no error.
+   */
+  simdjson_warn_unused virtual error_code stage1_start() noexcept { return SUCCESS; }
+  simdjson_warn_unused virtual error_code stage1_next(const uint8_t *, size_t) noexcept { return SUCCESS; }
+  simdjson_warn_unused virtual error_code stage1_end(const uint8_t *buf, size_t len) noexcept { return stage1(buf, len, stage1_mode::regular); }
+
   /**
    * @private For internal implementation use
    *
@@ -3003,6 +3030,10 @@ public:
   std::unique_ptr<uint32_t[]> structural_indexes{};
   /** Next structural index to parse */
   uint32_t next_structural_index{0};
+  /** Whether stage 1 validates UTF-8. Only turn it off for input that's known to be valid. */
+  bool validate_utf8{true};
+  /** @private The state of the incremental stage 1 in progress, if any */
+  std::unique_ptr<incremental_stage1> incremental_stage1_state{};
 
   /**
    * The largest document this parser can support without reallocating.
@@ -4787,6 +4818,34 @@ public:
    */
   simdjson_warn_unused inline error_code allocate(size_t capacity, size_t max_depth = DEFAULT_MAX_DEPTH) noexcept;
 
+  /**
+   * Ensure this parser has enough memory to process JSON documents up to `capacity` bytes in length
+   * and `max_depth` depth, using the given implementation rather than the active one. Any memory
+   * the parser already had is released first.
+   *
+   * @param capacity The new capacity.
+   * @param max_depth The new max_depth.
+   * @param with The implementation to use from now on.
+   * @return The error, if there is one.
+   */
+  simdjson_warn_unused inline error_code allocate(size_t capacity, size_t max_depth, const simdjson::implementation *with) noexcept;
+
+  /**
+   * Whether stage 1 validates UTF-8. Only turn it off for input that's known to be valid. The
+   * parser must have been allocated, and keeps the setting until it's allocated with a different
+   * implementation.
+   */
+  inline void set_utf8_validation(bool enabled) noexcept;
+
+  /**
+   * Parse a document that stage 1 has already indexed, through implementation->stage1_start(),
+   * stage1_next() and stage1_end(), so that only stage 2 is left. The document is the buffer and
+   * length that were passed to stage1_end(), which must still be alive.
+   *
+   * @return The document, or an error.
+   */
+  inline simdjson_result<element> parse_indexed(size_t len) & noexcept;
+
 #ifndef SIMDJSON_DISABLE_DEPRECATED_API
   /**
    * @private deprecated because it returns bool instead of error_code, which is our standard for
@@ -4856,6 +4915,8 @@ public:
 
   /** @private [for benchmarking access] The implementation to use */
   std::unique_ptr<internal::dom_parser_implementation> implementation{};
+  /** @private The implementation passed to allocate(), if any */
+  const simdjson::implementation *allocated_with{nullptr};
 
   /** @private Use `if (parser.parse(...).error())` instead */
   bool valid{false};
@@ -5096,6 +5157,11 @@ public:
      * awkward and we would like to offer something friendlier.
      */
      simdjson_inline size_t current_index() const noexcept;
+    /**
+     * Gives the index in the input, in bytes, of the batch containing the current document. Locations
+     * from get_location_of_number_in_json() are relative to it.
+     */
+     simdjson_inline size_t current_batch_start() const noexcept;
     /**
      * @private
      *
@@ -7609,9 +7675,14 @@ inline void document_stream::start() noexcept {
   if (error) { return; }
 #ifdef SIMDJSON_THREADS_ENABLED
   if (use_thread && next_batch_start() < len) {
-    // Kick off the first thread if needed
+    // Kick off the first thread if needed, with the same implementation and settings as the main parser
+    if (parser->allocated_with) {
+      error = stage1_thread_parser.allocate(batch_size, parser->max_depth(), parser->allocated_with);
+      if (error) { return; }
+    }
     error = stage1_thread_parser.ensure_capacity(batch_size);
     if (error) { return; }
+    stage1_thread_parser.set_utf8_validation(parser->implementation->validate_utf8);
     worker->start_thread();
     start_stage1_thread();
     if (error) { return; }
@@ -7624,6 +7695,10 @@ simdjson_inline size_t document_stream::iterator::current_index() const noexcept
   return stream->doc_index;
 }
 
+simdjson_inline size_t document_stream::iterator::current_batch_start() const noexcept {
+  return stream->batch_start;
+}
+
 simdjson_inline std::string_view document_stream::iterator::source() const noexcept {
   const char* start = reinterpret_cast<const char*>(stream->buf) + current_index();
   bool object_or_array = ((*start == '[') || (*start == '{'));
@@ -8834,6 +8909,26 @@ inline error_code parser::allocate(size_t capacity, size_t max_depth) noexcept {
   return SUCCESS;
 }
 
+inline error_code parser::allocate(size_t capacity, size_t max_depth, const simdjson::implementation *with) noexcept {
+  implementation.reset();
+  allocated_with = with;
+  return with->create_dom_parser_implementation(capacity, max_depth, implementation);
+}
+
+inline void parser::set_utf8_validation(bool enabled) noexcept {
+  if (implementation) { implementation->validate_utf8 = enabled; }
+}
+
+inline simdjson_result<element> parser::parse_indexed(size_t len) & noexcept {
+  // Only the document can need allocating: reallocating the parser would lose what stage 1 found
+  size_t desired_capacity = len < MINIMAL_DOCUMENT_CAPACITY ? MINIMAL_DOCUMENT_CAPACITY : len;
+  error_code _error = doc.capacity() < desired_capacity ? doc.allocate(desired_capacity) : SUCCESS;
+  if (_error) { return error = _error; }
+  _error = implementation->stage2(doc);
+  if (_error) { return _error; }
+  return doc.root();
+}
+
 #ifndef SIMDJSON_DISABLE_DEPRECATED_API
 simdjson_warn_unused
 inline bool parser::allocate_capacity(size_t capacity, size_t max_depth) noexcept {
@@ -9726,6 +9821,9 @@ public:
 
   simdjson_warn_unused error_code parse(const uint8_t *buf, size_t len, dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage1(const uint8_t *buf, size_t len, stage1_mode partial) noexcept final;
+  simdjson_warn_unused error_code stage1_start() noexcept final;
+  simdjson_warn_unused error_code stage1_next(const uint8_t *buf, size_t len) noexcept final;
+  simdjson_warn_unused error_code stage1_end(const uint8_t *buf, size_t len) noexcept final;
   simdjson_warn_unused error_code stage2(dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage2_next(dom::document &doc) noexcept final;
   simdjson_warn_unused uint8_t *parse_string(const uint8_t *src, uint8_t *dst) const noexcept final;
@@ -9751,6 +9849,7 @@ inline simdjson_warn_unused error_code dom_parser_implementation::set_capacity(s
   if(capacity > SIMDJSON_MAXSIZE_BYTES) { return CAPACITY; }
   // Stage 1 index output
   size_t max_structures = SIMDJSON_ROUNDUP_N(capacity, 64) + 2 + 7;
+  incremental_stage1_state.reset();
   structural_indexes.reset( new (std::nothrow) uint32_t[max_structures] );
   if (!structural_indexes) { _capacity = 0; return MEMALLOC; }
   structural_indexes[0] = 0;
@@ -12095,6 +12194,7 @@ inline simdjson_warn_unused error_code dom_parser_implementation::set_capacity(s
   if(capacity > SIMDJSON_MAXSIZE_BYTES) { return CAPACITY; }
   // Stage 1 index output
   size_t max_structures = SIMDJSON_ROUNDUP_N(capacity, 64) + 2 + 7;
+  incremental_stage1_state.reset();
   structural_indexes.reset( new (std::nothrow) uint32_t[max_structures] );
   if (!structural_indexes) { _capacity = 0; return MEMALLOC; }
   structural_indexes[0] = 0;
@@ -13841,6 +13941,9 @@ public:
 
   simdjson_warn_unused error_code parse(const uint8_t *buf, size_t len, dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage1(const uint8_t *buf, size_t len, stage1_mode partial) noexcept final;
+  simdjson_warn_unused error_code stage1_start() noexcept final;
+  simdjson_warn_unused error_code stage1_next(const uint8_t *buf, size_t len) noexcept final;
+  simdjson_warn_unused error_code stage1_end(const uint8_t *buf, size_t len) noexcept final;
   simdjson_warn_unused error_code stage2(dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage2_next(dom::document &doc) noexcept final;
   simdjson_warn_unused uint8_t *parse_string(const uint8_t *src, uint8_t *dst) const noexcept final;
@@ -13866,6 +13969,7 @@ inline simdjson_warn_unused error_code dom_parser_implementation::set_capacity(s
   if(capacity > SIMDJSON_MAXSIZE_BYTES) { return CAPACITY; }
   // Stage 1 index output
   size_t max_structures = SIMDJSON_ROUNDUP_N(capacity, 64) + 2 + 7;
+  incremental_stage1_state.reset();
   structural_indexes.reset( new (std::nothrow) uint32_t[max_structures] );
   if (!structural_indexes) { _capacity = 0; return MEMALLOC; }
   structural_indexes[0] = 0;
@@ -16031,6 +16135,9 @@ public:
 
   simdjson_warn_unused error_code parse(const uint8_t *buf, size_t len, dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage1(const uint8_t *buf, size_t len, stage1_mode partial) noexcept final;
+  simdjson_warn_unused error_code stage1_start() noexcept final;
+  simdjson_warn_unused error_code stage1_next(const uint8_t *buf, size_t len) noexcept final;
+  simdjson_warn_unused error_code stage1_end(const uint8_t *buf, size_t len) noexcept final;
   simdjson_warn_unused error_code stage2(dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage2_next(dom::document &doc) noexcept final;
   simdjson_warn_unused uint8_t *parse_string(const uint8_t *src, uint8_t *dst) const noexcept final;
@@ -16056,6 +16163,7 @@ inline simdjson_warn_unused error_code dom_parser_implementation::set_capacity(s
   if(capacity > SIMDJSON_MAXSIZE_BYTES) { return CAPACITY; }
   // Stage 1 index output
   size_t max_structures = SIMDJSON_ROUNDUP_N(capacity, 64) + 2 + 7;
+  incremental_stage1_state.reset();
   structural_indexes.reset( new (std::nothrow) uint32_t[max_structures] );
   if (!structural_indexes) { _capacity = 0; return MEMALLOC; }
   structural_indexes[0] = 0;
@@ -18151,6 +18259,9 @@ public:
 
   simdjson_warn_unused error_code parse(const uint8_t *buf, size_t len, dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage1(const uint8_t *buf, size_t len, stage1_mode partial) noexcept final;
+  simdjson_warn_unused error_code stage1_start() noexcept final;
+  simdjson_warn_unused error_code stage1_next(const uint8_t *buf, size_t len) noexcept final;
+  simdjson_warn_unused error_code stage1_end(const uint8_t *buf, size_t len) noexcept final;
   simdjson_warn_unused error_code stage2(dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage2_next(dom::document &doc) noexcept final;
   simdjson_warn_unused uint8_t *parse_string(const uint8_t *src, uint8_t *dst) const noexcept final;
@@ -18176,6 +18287,7 @@ inline simdjson_warn_unused error_code dom_parser_implementation::set_capacity(s
   if(capacity > SIMDJSON_MAXSIZE_BYTES) { return CAPACITY; }
   // Stage 1 index output
   size_t max_structures = SIMDJSON_ROUNDUP_N(capacity, 64) + 2 + 7;
+  incremental_stage1_state.reset();
   structural_indexes.reset( new (std::nothrow) uint32_t[max_structures] );
   if (!structural_indexes) { _capacity = 0; return MEMALLOC; }
   structural_indexes[0] = 0;
@@ -20486,6 +20598,9 @@ public:
 
   simdjson_warn_unused error_code parse(const uint8_t *buf, size_t len, dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage1(const uint8_t *buf, size_t len, stage1_mode partial) noexcept final;
+  simdjson_warn_unused error_code stage1_start() noexcept final;
+  simdjson_warn_unused error_code stage1_next(const uint8_t *buf, size_t len) noexcept final;
+  simdjson_warn_unused error_code stage1_end(const uint8_t *buf, size_t len) noexcept final;
   simdjson_warn_unused error_code stage2(dom::document &doc) noexcept final;
   simdjson_warn_unused error_code stage2_next(dom::document &doc) noexcept final;
   simdjson_warn_unused uint8_t *parse_string(const uint8_t *src, uint8_t *dst) const noexcept final;
@@ -20511,6 +20626,7 @@ inline simdjson_warn_unused error_code dom_parser_implementation::set_capacity(s
   if(capacity > SIMDJSON_MAXSIZE_BYTES) { return CAPACITY; }
   // Stage 1 index output
   size_t max_structures = SIMDJSON_ROUNDUP_N(capacity, 64) + 2 + 7;
+  incremental_stage1_state.reset();
   structural_indexes.reset( new (std::nothrow) uint32_t[max_structures] );
   if (!structural_indexes) { _capacity = 0; return MEMALLOC; }
   structural_indexes[0] = 0;
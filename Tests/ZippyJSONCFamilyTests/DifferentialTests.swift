@@ -0,0 +1,187 @@
+import XCTest
+@testable import ZippyJSONCFamily
+
+// The same JSON goes through both decoder engines, or through the validator and the parser, and the answers have to
+// agree
+final class DifferentialTests: XCTestCase {
+    // A fixed sequence, so that a failure can be reproduced
+    private struct Generator {
+        var state: UInt64
+
+        mutating func next(_ count: Int) -> Int {
+            state = state &* 6364136223846793005 &+ 1442695040888963407
+            return Int((state >> 33) % UInt64(count))
+        }
+    }
+
+    private static let stringParts = ["a", "word", "\\n", "\\\"", "\\u0041", "\\u00e9", "\\ud83d\\ude00", "é", "€", "😀", " ", "\\\\", "\\/"]
+    private static let numbers = ["0", "-1", "42", "9007199254740993", "-9223372036854775808", "1.5", "-0.25", "1e10", "6.02e-23", "3.141592653589793"]
+    private static let atoms = ["true", "false", "null"]
+
+    private func string(_ generator: inout Generator) -> String {
+        var string = "\""
+        for _ in 0..<generator.next(8) {
+            string += DifferentialTests.stringParts[generator.next(DifferentialTests.stringParts.count)]
+        }
+        return string + "\""
+    }
+
+    // Random JSON, with ASCII keys that are unique within each object
+    private func value(_ generator: inout Generator, depth: Int) -> String {
+        switch depth > 3 ? generator.next(4) : generator.next(7) {
+        case 0:
+            return DifferentialTests.numbers[generator.next(DifferentialTests.numbers.count)]
+        case 1:
+            return String(generator.next(100000) - 50000)
+        case 2:
+            return string(&generator)
+        case 3:
+            return DifferentialTests.atoms[generator.next(DifferentialTests.atoms.count)]
+        case 4, 5:
+            let count = generator.next(6)
+            let first = generator.next(20)
+            var fields: [String] = []
+            for i in 0..<count {
+                fields.append("\"k\(first + i)\": " + value(&generator, depth: depth + 1))
+            }
+            return "{" + fields.joined(separator: ", ") + "}"
+        default:
+            let count = generator.next(6)
+            var elements: [String] = []
+            for _ in 0..<count {
+                elements.append(value(&generator, depth: depth + 1))
+            }
+            return "[" + elements.joined(separator: ", ") + "]"
+        }
+    }
+
+    // Parses the JSON into a new context that uses the engine, and passes the root (nil if it couldn't be parsed) to body
+    // while the context is still alive
+    private func withDocument<T>(_ json: [UInt8], engine: JNTDecoderEngine, _ body: (ContextPointer, JNTDecoder?) -> T) -> T {
+        return json.withUnsafeBytes { buffer in
+            let context: ContextPointer = JNTCreateContext(nil, 0, "-inf", "inf", "nan", false)
+            defer {
+                JNTReleaseContext(context)
+            }
+            JNTSetDecoderEngine(context, engine)
+            var retryReason: UnsafePointer<CChar>?
+            var success = false
+            let root = JNTDocumentFromJSON(context, buffer.baseAddress, buffer.count, false, &retryReason, &success)
+            return body(context, success ? root : nil)
+        }
+    }
+
+    // Everything the decoders can read from the value. Keys are looked up in reverse order, so the on-demand engine has
+    // to rewind for each one
+    private func describe(_ value: JNTDecoder) -> String {
+        let context = JNTGetContext(value)
+        if JNTDocumentDecodeNil(value) {
+            return "null"
+        }
+        JNTClearError(context)
+        if JNTDocumentValueIsDictionary(value) {
+            var iterator = JNTDocumentGetDictionaryIterator(value)
+            var fields: [String] = []
+            for key in JNTDocumentAllKeys(value).reversed() {
+                let field = JNTDocumentFetchValue(value, key, &iterator)
+                fields.append("\(key.debugDescription): \(describe(field))")
+            }
+            return "{" + fields.reversed().joined(separator: ", ") + "}"
+        }
+        if JNTDocumentValueIsArray(value) {
+            var iterator = JNTDocumentGetIterator(value)
+            var elements: [String] = []
+            for _ in 0..<JNTDocumentGetArrayCount(value) {
+                elements.append(describe(JNTDecoderFromIterator(&iterator, value)))
+                JNTAdvanceIterator(&iterator, value)
+            }
+            return "[" + elements.joined(separator: ", ") + "]"
+        }
+        if JNTDocumentValueIsNumber(value) {
+            if JNTDocumentValueIsInteger(value) {
+                let integer = JNTDocumentDecode__Int(value)
+                if !JNTErrorDidOccur(context) {
+                    return "\(integer)"
+                }
+                JNTClearError(context)
+                return "\(JNTDocumentDecode__UInt(value))"
+            }
+            return "\(JNTDocumentDecode__Double(value))"
+        }
+        if let string = JNTDocumentDecode__String(value), !JNTErrorDidOccur(context) {
+            return String(cString: string).debugDescription
+        }
+        JNTClearError(context)
+        let bool = JNTDocumentDecode__Bool(value)
+        return JNTErrorDidOccur(context) ? "error" : "\(bool)"
+    }
+
+    func testEnginesAgree() {
+        var generator = Generator(state: 28)
+        for _ in 0..<2000 {
+            let json = Array(value(&generator, depth: 0).utf8)
+            let dom = withDocument(json, engine: .DOM) { _, root in root.map(describe) }
+            let onDemand = withDocument(json, engine: .onDemand) { _, root in root.map(describe) }
+            XCTAssertNotNil(dom, String(decoding: json, as: UTF8.self))
+            XCTAssertEqual(dom, onDemand, String(decoding: json, as: UTF8.self))
+        }
+    }
+
+    func testValidatorAgreesWithParser() {
+        var generator = Generator(state: 29)
+        let replacements: [UInt8] = [0xFF, 0x01, UInt8(ascii: "\""), UInt8(ascii: "{"), UInt8(ascii: "]"), 0xC3, UInt8(ascii: ":"), UInt8(ascii: ",")]
+        for _ in 0..<5000 {
+            var json = Array(value(&generator, depth: 0).utf8)
+            // Truncated, with a byte replaced, with something after the root, or left alone
+            switch generator.next(4) {
+            case 0:
+                json = Array(json.prefix(generator.next(json.count + 1)))
+            case 1 where !json.isEmpty:
+                let replacement = replacements[generator.next(replacements.count)]
+                json[generator.next(json.count)] = replacement
+            case 2:
+                json += Array(" x".utf8)
+            default:
+                break
+            }
+            var errorOffset = 0
+            let valid = json.withUnsafeBytes { buffer in
+                JNTValidateJSON(buffer.baseAddress, buffer.count, &errorOffset)
+            }
+            let parsed = withDocument(json, engine: .DOM) { _, root in root != nil }
+            XCTAssertEqual(valid, parsed, String(decoding: json, as: UTF8.self))
+        }
+    }
+
+    func testOutOfOrderAndEscapedKeys() {
+        let json = Array(#"{"plain": 1, "with\"quote": 2, "new\nline": 3, "\u0041BC": 4, "slash\/": 5, "back\\slash": 6, "last": 7}"#.utf8)
+        let keys = ["plain", "with\"quote", "new\nline", "ABC", "slash/", "back\\slash", "last"]
+        for engine in [JNTDecoderEngine.DOM, .onDemand] {
+            var generator = Generator(state: 30)
+            withDocument(json, engine: engine) { context, root in
+                guard let root = root else {
+                    XCTFail("Couldn't parse the JSON")
+                    return
+                }
+                // Keys in a random order, so lookups go backwards as well as forwards, and now and then one that's
+                // missing
+                var iterator = JNTDocumentGetDictionaryIterator(root)
+                for _ in 0..<200 {
+                    let index = generator.next(keys.count + 1)
+                    if index == keys.count {
+                        XCTAssertFalse(JNTDocumentContains(root, "missing", &iterator))
+                        continue
+                    }
+                    XCTAssertEqual(JNTDocumentDecodeKeyed__Int(root, keys[index], &iterator), index + 1, keys[index])
+                    XCTAssertFalse(JNTErrorDidOccur(context), keys[index])
+                }
+            }
+        }
+    }
+
+    static var allTests = [
+        ("testEnginesAgree", testEnginesAgree),
+        ("testValidatorAgreesWithParser", testValidatorAgreesWithParser),
+        ("testOutOfOrderAndEscapedKeys", testOutOfOrderAndEscapedKeys),
+    ]
+}
@@ -0,0 +1,88 @@
+import XCTest
+@testable import ZippyJSONCFamily
+
+final class ParallelDecodeTests: XCTestCase {
+    private static let count = 5000
+
+    // More than one range of elements, so that several workers get some
+    private static let json = Array(("[" + (0..<count).map { "\($0 * 3)" }.joined(separator: ", ") + "]").utf8)
+
+    // The elements at 3000 and 4500 are strings, and the error has to be the lower one's whichever worker gets there first
+    private static let invalidJSON = Array(("[" + (0..<count).map { index -> String in
+        return index == 3000 || index == 4500 ? "\"bad\(index)\"" : "\(index * 3)"
+    }.joined(separator: ", ") + "]").utf8)
+
+    // Parses the JSON into a context that configure has set up, and decodes every element of the root as an Int in
+    // parallel. Returns the result, the times each element was seen, and what it decoded to
+    private func decodeInParallel(_ json: [UInt8], configure: (ContextPointer) -> Void, _ body: (ContextPointer, Bool, [Int], [Int]) -> Void) {
+        json.withUnsafeBytes { buffer in
+            let context: ContextPointer = JNTCreateContext(nil, 0, "-inf", "inf", "nan", false)
+            defer {
+                JNTReleaseContext(context)
+            }
+            configure(context)
+            var retryReason: UnsafePointer<CChar>?
+            var success = false
+            let root = JNTDocumentFromJSON(context, buffer.baseAddress, buffer.count, false, &retryReason, &success)
+            XCTAssertTrue(success)
+            guard success else {
+                return
+            }
+            let lock = NSLock()
+            var timesSeen = Array(repeating: 0, count: ParallelDecodeTests.count)
+            var values = Array(repeating: -1, count: ParallelDecodeTests.count)
+            let result = JNTDocumentDecodeArrayInParallel(root, 4) { index, element in
+                let value = JNTDocumentDecode__Int(element)
+                lock.lock()
+                timesSeen[index] += 1
+                values[index] = value
+                lock.unlock()
+            }
+            body(context, result, timesSeen, values)
+        }
+    }
+
+    private func check(configure: (ContextPointer) -> Void) {
+        decodeInParallel(ParallelDecodeTests.json, configure: configure) { context, result, timesSeen, values in
+            XCTAssertTrue(result)
+            XCTAssertFalse(JNTErrorDidOccur(context))
+            XCTAssertEqual(timesSeen, Array(repeating: 1, count: ParallelDecodeTests.count))
+            XCTAssertEqual(values, (0..<ParallelDecodeTests.count).map { $0 * 3 })
+        }
+        decodeInParallel(ParallelDecodeTests.invalidJSON, configure: configure) { context, result, timesSeen, values in
+            XCTAssertFalse(result)
+            XCTAssertTrue(JNTErrorDidOccur(context))
+            // Everything before the first error is decoded, and nothing more than once
+            XCTAssertEqual(Array(timesSeen[..<3000]), Array(repeating: 1, count: 3000))
+            XCTAssertEqual(Array(values[..<3000]), (0..<3000).map { $0 * 3 })
+            XCTAssertTrue(timesSeen.allSatisfy { $0 <= 1 })
+            var info = JNTErrorInfo()
+            JNTGetErrorInfo(context, &info)
+            XCTAssertEqual(JNTDocumentDecode__String(info.value).map { String(cString: $0) }, "bad3000")
+        }
+    }
+
+    func testDOM() {
+        check { _ in }
+    }
+
+    // The parallel parse splits the root into chunks, so the workers' iterators have to cross from one to the next
+    func testChunkedRoot() {
+        check { context in
+            JNTSetParallelParsing(context, 4, 0)
+        }
+    }
+
+    // On-demand documents get a single worker
+    func testOnDemand() {
+        check { context in
+            JNTSetDecoderEngine(context, .onDemand)
+        }
+    }
+
+    static var allTests = [
+        ("testDOM", testDOM),
+        ("testChunkedRoot", testChunkedRoot),
+        ("testOnDemand", testOnDemand),
+    ]
+}
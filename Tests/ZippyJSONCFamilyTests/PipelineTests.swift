@@ -0,0 +1,126 @@
+import XCTest
+@testable import ZippyJSONCFamily
+
+final class PipelineTests: XCTestCase {
+    private func createContexts(_ count: Int, engine: JNTDecoderEngine = .DOM) -> [ContextPointer?] {
+        return (0..<count).map { _ in
+            let context: ContextPointer = JNTCreateContext(nil, 0, "-inf", "inf", "nan", false)
+            JNTSetDecoderEngine(context, engine)
+            return context
+        }
+    }
+
+    // The pipeline parses payloads on its own thread, so they're copied somewhere that stays valid until they're freed
+    private func copyPayloads(_ strings: [String]) -> [UnsafeMutablePointer<CChar>] {
+        return strings.map { strdup($0)! }
+    }
+
+    private func submit(_ pipeline: PipelinePointer, _ payload: UnsafeMutablePointer<CChar>) -> Bool {
+        return JNTPipelineSubmit(pipeline, payload, strlen(payload))
+    }
+
+    // Submits the payloads and then finishes the pipeline, on another thread, since submitting blocks until the host
+    // recycles a context
+    private func submitInBackground(_ pipeline: PipelinePointer, _ payloads: [UnsafeMutablePointer<CChar>], group: DispatchGroup) {
+        DispatchQueue.global().async(group: group) {
+            for payload in payloads {
+                XCTAssertTrue(self.submit(pipeline, payload))
+            }
+            JNTPipelineFinish(pipeline)
+        }
+    }
+
+    // The next payload's root, the context it was parsed into, and whether it parsed, or nil at the end
+    private func next(_ pipeline: PipelinePointer) -> (root: JNTDecoder, context: ContextPointer, success: Bool)? {
+        var context: ContextPointer?
+        var isAtEnd = false
+        var retryReason: UnsafePointer<CChar>?
+        var success = false
+        let root = JNTPipelineNext(pipeline, &context, &isAtEnd, &retryReason, &success)
+        guard !isAtEnd, let parsedContext = context else {
+            return nil
+        }
+        return (root, parsedContext, success)
+    }
+
+    func testInOrderWithFewerContextsThanPayloads() {
+        let strings = (0..<50).map { index -> String in
+            let values = Array(repeating: "1", count: index * 1000).joined(separator: ", ")
+            return "{\"index\": \(index), \"values\": [\(values)]}"
+        }
+        for engine in [JNTDecoderEngine.DOM, .onDemand] {
+            let payloads = copyPayloads(strings)
+            var contexts = createContexts(3, engine: engine)
+            let pipeline: PipelinePointer = JNTPipelineCreate(&contexts, contexts.count, false)
+            let group = DispatchGroup()
+            submitInBackground(pipeline, payloads, group: group)
+            var index = 0
+            while let payload = next(pipeline) {
+                XCTAssertTrue(payload.success)
+                if payload.success {
+                    var iterator = JNTDocumentGetDictionaryIterator(payload.root)
+                    XCTAssertEqual(JNTDocumentDecodeKeyed__Int(payload.root, "index", &iterator), index)
+                    XCTAssertEqual(JNTDocumentGetArrayCount(JNTDocumentFetchValue(payload.root, "values", &iterator)), index * 1000)
+                }
+                index += 1
+                JNTPipelineRecycle(pipeline, payload.context)
+            }
+            XCTAssertEqual(index, strings.count)
+            group.wait()
+            JNTPipelineRelease(pipeline)
+            contexts.forEach { JNTReleaseContext($0) }
+            payloads.forEach { free($0) }
+        }
+    }
+
+    func testMalformedPayload() {
+        let payloads = copyPayloads(["[1, 2]", "[1, 2", "[3]"])
+        var contexts = createContexts(2)
+        let pipeline: PipelinePointer = JNTPipelineCreate(&contexts, contexts.count, false)
+        let group = DispatchGroup()
+        submitInBackground(pipeline, payloads, group: group)
+        var successes: [Bool] = []
+        while let payload = next(pipeline) {
+            successes.append(payload.success)
+            if payload.success {
+                XCTAssertTrue(JNTDocumentValueIsArray(payload.root))
+            }
+            // The context of a payload that failed goes back into the ring too
+            JNTPipelineRecycle(pipeline, payload.context)
+        }
+        XCTAssertEqual(successes, [true, false, true])
+        group.wait()
+        JNTPipelineRelease(pipeline)
+        contexts.forEach { JNTReleaseContext($0) }
+        payloads.forEach { free($0) }
+    }
+
+    func testCancelWhileParsing() {
+        let payloads = copyPayloads(["[" + String(repeating: "{\"a\": [1, 2.5, \"s\"]}, ", count: 500000) + "0]", "[]"])
+        // Cancelling at different points of the parse
+        for delay in 0..<20 {
+            var contexts = createContexts(1)
+            let pipeline: PipelinePointer = JNTPipelineCreate(&contexts, contexts.count, false)
+            XCTAssertTrue(submit(pipeline, payloads[0]))
+            DispatchQueue.global().asyncAfter(deadline: .now() + .milliseconds(delay)) {
+                JNTPipelineCancel(pipeline)
+            }
+            // The only context is taken, so this blocks until the pipeline is cancelled
+            XCTAssertFalse(submit(pipeline, payloads[1]))
+            // The payload may or may not have been parsed by the time of the cancel, but if it was, it's intact
+            if let payload = next(pipeline) {
+                XCTAssertTrue(payload.success)
+                XCTAssertEqual(JNTDocumentGetArrayCount(payload.root), 500001)
+            }
+            JNTPipelineRelease(pipeline)
+            contexts.forEach { JNTReleaseContext($0) }
+        }
+        payloads.forEach { free($0) }
+    }
+
+    static var allTests = [
+        ("testInOrderWithFewerContextsThanPayloads", testInOrderWithFewerContextsThanPayloads),
+        ("testMalformedPayload", testMalformedPayload),
+        ("testCancelWhileParsing", testCancelWhileParsing),
+    ]
+}
@@ -0,0 +1,112 @@
+import XCTest
+@testable import ZippyJSONCFamily
+
+final class ReaderTests: XCTestCase {
+    // Snake case keys and escaped strings, so that readers depend on both being converted once for the whole document
+    private static let json = Array(#"{"user_name": "a\"b", "user_id": 7, "tags": ["x\ny", "é"], "nested_object": {"inner_value": 1.5}}"#.utf8)
+    private static let readerCount = 4
+    private static let rounds = 20
+
+    // Parses the JSON into a new context (the owner) with convertCase on, and passes it and the root to body. Whoever
+    // releases the owner is up to body, since readers can outlive it
+    private func withOwner(engine: JNTDecoderEngine, _ body: (ContextPointer, JNTDecoder) -> Void) {
+        ReaderTests.json.withUnsafeBytes { buffer in
+            let owner: ContextPointer = JNTCreateContext(nil, 0, "-inf", "inf", "nan", false)
+            JNTSetDecoderEngine(owner, engine)
+            var retryReason: UnsafePointer<CChar>?
+            var success = false
+            let root = JNTDocumentFromJSON(owner, buffer.baseAddress, buffer.count, true, &retryReason, &success)
+            XCTAssertTrue(success)
+            guard success else {
+                JNTReleaseContext(owner)
+                return
+            }
+            body(owner, root)
+        }
+    }
+
+    // Decodes everything with converted keys, as the host would, and returns whether it all came out as expected
+    private func decodesAsExpected(_ root: JNTDecoder) -> Bool {
+        let context = JNTGetContext(root)
+        JNTConvertSnakeToCamel(root)
+        var iterator = JNTDocumentGetDictionaryIterator(root)
+        let name = JNTDocumentDecodeKeyed__String(root, "userName", &iterator).map { String(cString: $0) }
+        let id = JNTDocumentDecodeKeyed__Int(root, "userId", &iterator)
+        let tags = JNTDocumentFetchValue(root, "tags", &iterator)
+        var tagIterator = JNTDocumentGetIterator(tags)
+        let firstTag = JNTDocumentDecode__String(JNTDecoderFromIterator(&tagIterator, tags)).map { String(cString: $0) }
+        JNTAdvanceIterator(&tagIterator, tags)
+        let secondTag = JNTDocumentDecode__String(JNTDecoderFromIterator(&tagIterator, tags)).map { String(cString: $0) }
+        let nested = JNTDocumentFetchValue(root, "nestedObject", &iterator)
+        JNTConvertSnakeToCamel(nested)
+        var nestedIterator = JNTDocumentGetDictionaryIterator(nested)
+        let innerValue = JNTDocumentDecodeKeyed__Double(nested, "innerValue", &nestedIterator)
+        let expected = !JNTErrorDidOccur(context) && name == "a\"b" && id == 7 && firstTag == "x\ny" && secondTag == "é" && innerValue == 1.5
+        JNTClearError(context)
+        return expected
+    }
+
+    // Decodes each root many times, each on a thread of its own, and returns how many of those decodes went wrong
+    private func failuresDecodingConcurrently(_ roots: [JNTDecoder]) -> Int {
+        let lock = NSLock()
+        var failures = 0
+        DispatchQueue.concurrentPerform(iterations: roots.count) { index in
+            let rootFailures = (0..<100).filter { _ in !decodesAsExpected(roots[index]) }.count
+            lock.lock()
+            failures += rootFailures
+            lock.unlock()
+        }
+        return failures
+    }
+
+    func testConcurrentReaders() {
+        for engine in [JNTDecoderEngine.DOM, .onDemand] {
+            for _ in 0..<ReaderTests.rounds {
+                withOwner(engine: engine) { owner, root in
+                    // Created at the same time on different threads, which all want the document materialized
+                    let readers = UnsafeMutableBufferPointer<ContextPointer?>.allocate(capacity: ReaderTests.readerCount)
+                    DispatchQueue.concurrentPerform(iterations: readers.count) { index in
+                        readers[index] = JNTCreateReader(owner)
+                    }
+                    XCTAssertFalse(readers.contains { $0 == nil })
+                    // The owner keeps decoding at the same time as its readers
+                    XCTAssertEqual(failuresDecodingConcurrently(readers.map { JNTReaderGetRoot($0) } + [root]), 0)
+                    readers.forEach { JNTReleaseContext($0) }
+                    readers.deallocate()
+                    JNTReleaseContext(owner)
+                }
+            }
+        }
+    }
+
+    func testReleasingOwnerBeforeReaders() {
+        for engine in [JNTDecoderEngine.DOM, .onDemand] {
+            for _ in 0..<ReaderTests.rounds {
+                withOwner(engine: engine) { owner, _ in
+                    let readers = (0..<ReaderTests.readerCount).map { _ in JNTCreateReader(owner) }
+                    JNTReleaseContext(owner)
+                    XCTAssertEqual(failuresDecodingConcurrently(readers.map { JNTReaderGetRoot($0) }), 0)
+                    readers.forEach { JNTReleaseContext($0) }
+                }
+            }
+        }
+    }
+
+    func testStreamDocumentsAreNotShared() {
+        let json = Array("[1] [2] [3]".utf8)
+        json.withUnsafeBytes { buffer in
+            let context: ContextPointer = JNTCreateContext(nil, 0, "-inf", "inf", "nan", false)
+            var retryReason: UnsafePointer<CChar>?
+            XCTAssertTrue(JNTDocumentStreamFromJSON(context, buffer.baseAddress, buffer.count, 1000000, 1, &retryReason))
+            XCTAssertNil(JNTCreateReader(context))
+            JNTDocumentStreamClose(context)
+            JNTReleaseContext(context)
+        }
+    }
+
+    static var allTests = [
+        ("testConcurrentReaders", testConcurrentReaders),
+        ("testReleasingOwnerBeforeReaders", testReleasingOwnerBeforeReaders),
+        ("testStreamDocumentsAreNotShared", testStreamDocumentsAreNotShared),
+    ]
+}
@@ -4,6 +4,10 @@ import XCTest
 public func allTests() -> [XCTestCaseEntry] {
     return [
         testCase(ZippyJSONCFamilyTests.allTests),
+        testCase(DifferentialTests.allTests),
+        testCase(ParallelDecodeTests.allTests),
+        testCase(PipelineTests.allTests),
+        testCase(ReaderTests.allTests),
     ]
 }
 #endif